@@ -1,11 +1,32 @@
 #pragma once
 
 #include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/ignore.hpp>
+#include <eosio/singleton.hpp>
 #include <eosio/transaction.hpp>
 
+#include <optional>
+
+#ifdef LEGACY_APPROVALS_FALLBACK
+#undef LEGACY_APPROVALS_FALLBACK
+#endif
+// LEGACY_APPROVALS_FALLBACK macro determines whether proposals without a row in the approvals2 table are looked up
+// in the legacy approvals table. Once all legacy approvals are migrated with `migrateapps`, the macro can be set
+// to 0 to save that lookup.
+#define LEGACY_APPROVALS_FALLBACK 1
+
 namespace eosio {
+
+   /**
+    * A single proposal approved by an `approvemany` action.
+    */
+   struct proposal_approval {
+      name                                proposer;
+      name                                proposal_name;
+      std::optional<eosio::checksum256>   proposal_hash;
+   };
     
    /**
     * @defgroup eosiomsig eosio.msig
@@ -36,6 +57,37 @@ namespace eosio {
          [[eosio::action]]
          void propose(ignore<name> proposer, ignore<name> proposal_name,
                ignore<std::vector<permission_level>> requested, ignore<transaction> trx);
+         /**
+          * Propose begin action, starts the upload of a proposal whose transaction is too large to be
+          * proposed in a single action. The packed transaction is then uploaded in chunks with `propappend`
+          * and the proposal is created by `propfinalize`. Beginning an upload that already exists restarts it.
+          * Storage changes are billed to `proposer`.
+          *
+          * @param proposer - The account proposing a transaction
+          * @param proposal_name - The name of the proposal (should be unique for proposer)
+          * @param requested - Permission levels expected to approve the proposal
+          */
+         [[eosio::action]]
+         void propbegin( name proposer, name proposal_name, std::vector<permission_level> requested );
+         /**
+          * Propose append action, appends a chunk of the packed transaction to an upload started by `propbegin`.
+          *
+          * @param proposer - The account proposing a transaction
+          * @param proposal_name - The name of the proposal being uploaded
+          * @param chunk - The next bytes of the packed transaction
+          */
+         [[eosio::action]]
+         void propappend( name proposer, name proposal_name, const std::vector<char>& chunk );
+         /**
+          * Propose finalize action, creates the proposal from a completed upload. The uploaded transaction
+          * goes through the same validations as with `propose`, its authorization being checked only once here,
+          * and the upload is erased.
+          *
+          * @param proposer - The account proposing a transaction
+          * @param proposal_name - The name of the proposal being uploaded
+          */
+         [[eosio::action]]
+         void propfinalize( name proposer, name proposal_name );
          /**
           * Approve action approves an existing proposal. Allows an account, the owner of `level` permission, to approve a proposal `proposal_name`
           * proposed by `proposer`. If the proposal's requested approval list contains the `level`
@@ -51,6 +103,15 @@ namespace eosio {
          [[eosio::action]]
          void approve( name proposer, name proposal_name, permission_level level,
                        const eosio::binary_extension<eosio::checksum256>& proposal_hash );
+         /**
+          * Approve many action approves several existing proposals with the same `level` permission in one action,
+          * as if `approve` was called for each of them in order. The action fails if any of the approvals fails.
+          *
+          * @param level - Permission level approving the transactions
+          * @param proposals - The proposer, name and optional transaction checksum of each proposal to approve
+          */
+         [[eosio::action]]
+         void approvemany( permission_level level, const std::vector<proposal_approval>& proposals );
          /**
           * Unapprove action revokes an existing proposal. This action is the reverse of the `approve` action: if all validations pass
           * the `level` permission is erased from internal `provided_approvals` and added to the internal
@@ -72,9 +133,20 @@ namespace eosio {
           * Allows the `canceler` account to cancel the `proposal_name` proposal, created by a `proposer`,
           * only after time has expired on the proposed transaction. It removes corresponding entries from
           * internal proptable and from approval (or old approvals) tables as well.
+          * An upload that has not been finalized can be cancelled by its proposer.
           */
          [[eosio::action]]
          void cancel( name proposer, name proposal_name, name canceler );
+         /**
+          * Garbage collect expired proposals action, cancels up to `max` expired proposals of any proposers,
+          * earliest expiration first, removing them from the proposals and approvals tables as `cancel` does.
+          * Anyone can call this action; the RAM of removed proposals is refunded to their proposers.
+          * Proposals made before the expiration index was added are not visited and have to be cancelled.
+          *
+          * @param max - The maximum number of proposals to remove
+          */
+         [[eosio::action]]
+         void gcexpired( uint32_t max );
          /**
           * Exec action allows an `executer` account to execute a proposal.
           *
@@ -94,6 +166,30 @@ namespace eosio {
           */
          [[eosio::action]]
          void exec( name proposer, name proposal_name, name executer );
+         /**
+          * Execute inline action, executes a proposal as `exec` does, except that the actions of the proposed
+          * transaction are sent as inline actions of this action instead of as a deferred transaction.
+          * They are executed immediately, and if any of them fails the proposal is kept.
+          *
+          * @param proposer - The account proposing a transaction
+          * @param proposal_name - The name of the proposal (should be an existing proposal)
+          * @param executer - The account executing the transaction
+          *
+          * @pre This contract has to be privileged,
+          * @pre The proposed transaction can have neither a delay nor context-free actions.
+          */
+         [[eosio::action]]
+         void execinline( name proposer, name proposal_name, name executer );
+         /**
+          * Migrate approvals action, moves up to `max` rows of the legacy approvals table, across the scopes of
+          * `proposers`, to the approvals2 table. Provided approvals are given no time, so that they are invalidated
+          * by any invalidation of their actor as with the legacy table. Storage is billed to the contract.
+          *
+          * @param proposers - The proposers whose legacy approvals are migrated
+          * @param max - The maximum number of rows to migrate
+          */
+         [[eosio::action]]
+         void migrateapps( const std::vector<name>& proposers, uint32_t max );
          /**
           * Invalidate action allows an `account` to invalidate itself, that is, its name is added to
           * the invalidations table and this table will be cross referenced when exec is performed.
@@ -102,13 +198,46 @@ namespace eosio {
           */
          [[eosio::action]]
          void invalidate( name account );
+         /**
+          * Initialize invalidations garbage collection action, enables pruning of the invalidations made from now on.
+          * Proposals stored before this contract tracked expirations, and the legacy approvals on them, are accounted
+          * for by `max_expiration`, which has to be no earlier than the furthest expiration of those proposals.
+          *
+          * @param max_expiration - The furthest expiration of the proposals stored before the upgrade
+          *
+          * @pre Requires authorization of this contract and can only be executed once.
+          */
+         [[eosio::action]]
+         void initgcinvals( time_point_sec max_expiration );
+         /**
+          * Garbage collect invalidations action, visits up to `max` invalidations starting from the account
+          * `lower_bound`, and removes those that can no longer affect any proposal, that is, invalidations
+          * made while every proposal then stored expires before now. Invalidations that can not be removed yet
+          * count towards `max`, so a table larger than `max` is walked by passing the account following the last
+          * one visited as `lower_bound` of the next call. Invalidations made before `initgcinvals` are never removed.
+          * Anyone can call this action; the RAM of removed invalidations is refunded to their accounts.
+          *
+          * @param lower_bound - The account to start visiting the invalidations from
+          * @param max - The maximum number of invalidations to visit
+          */
+         [[eosio::action]]
+         void gcinvals( name lower_bound, uint32_t max );
 
          using propose_action = eosio::action_wrapper<"propose"_n, &multisig::propose>;
+         using propbegin_action = eosio::action_wrapper<"propbegin"_n, &multisig::propbegin>;
+         using propappend_action = eosio::action_wrapper<"propappend"_n, &multisig::propappend>;
+         using propfinalize_action = eosio::action_wrapper<"propfinalize"_n, &multisig::propfinalize>;
          using approve_action = eosio::action_wrapper<"approve"_n, &multisig::approve>;
+         using approvemany_action = eosio::action_wrapper<"approvemany"_n, &multisig::approvemany>;
          using unapprove_action = eosio::action_wrapper<"unapprove"_n, &multisig::unapprove>;
          using cancel_action = eosio::action_wrapper<"cancel"_n, &multisig::cancel>;
+         using gcexpired_action = eosio::action_wrapper<"gcexpired"_n, &multisig::gcexpired>;
          using exec_action = eosio::action_wrapper<"exec"_n, &multisig::exec>;
+         using execinline_action = eosio::action_wrapper<"execinline"_n, &multisig::execinline>;
+         using migrateapps_action = eosio::action_wrapper<"migrateapps"_n, &multisig::migrateapps>;
          using invalidate_action = eosio::action_wrapper<"invalidate"_n, &multisig::invalidate>;
+         using initgcinvals_action = eosio::action_wrapper<"initgcinvals"_n, &multisig::initgcinvals>;
+         using gcinvals_action = eosio::action_wrapper<"gcinvals"_n, &multisig::gcinvals>;
 
       private:
          struct [[eosio::table]] proposal {
@@ -120,6 +249,39 @@ namespace eosio {
 
          typedef eosio::multi_index< "proposal"_n, proposal > proposals;
 
+         // Expiration index of the proposals of all proposers. `trx_hash` is the sha256 of the proposed transaction,
+         // so that approvals with a matching `proposal_hash` neither load nor rehash the transaction.
+         struct [[eosio::table]] proposal_expiry {
+            uint64_t             id;
+            name                 proposer;
+            name                 proposal_name;
+            time_point_sec       expiration;
+            eosio::checksum256   trx_hash;
+
+            uint64_t primary_key()const { return id; }
+            uint64_t by_expiration()const { return expiration.utc_seconds; }
+            uint128_t by_proposal()const { return proposal_key( proposer, proposal_name ); }
+
+            static uint128_t proposal_key( const name& proposer, const name& proposal_name ) {
+               return (uint128_t(proposer.value) << 64) | proposal_name.value;
+            }
+         };
+
+         typedef eosio::multi_index< "expiries"_n, proposal_expiry,
+                                     indexed_by<"byexpiration"_n, const_mem_fun<proposal_expiry, uint64_t, &proposal_expiry::by_expiration>>,
+                                     indexed_by<"byproposal"_n, const_mem_fun<proposal_expiry, uint128_t, &proposal_expiry::by_proposal>>
+                                   > proposal_expiries;
+
+         struct [[eosio::table]] upload {
+            name                            proposal_name;
+            std::vector<permission_level>   requested;
+            std::vector<char>               packed_transaction;
+
+            uint64_t primary_key()const { return proposal_name.value; }
+         };
+
+         typedef eosio::multi_index< "uploads"_n, upload > uploads;
+
          struct [[eosio::table]] old_approvals_info {
             name                            proposal_name;
             std::vector<permission_level>   requested_approvals;
@@ -134,6 +296,8 @@ namespace eosio {
             time_point       time;
          };
 
+         // From version 2 both lists are sorted by permission level, so that approvals are looked up
+         // with a binary search.
          struct [[eosio::table]] approvals_info {
             uint8_t                 version = 1;
             name                    proposal_name;
@@ -147,14 +311,51 @@ namespace eosio {
          };
          typedef eosio::multi_index< "approvals2"_n, approvals_info > approvals;
 
+         // `expiration_horizon` is the latest expiration of the proposals made before the invalidation, it is not set
+         // for invalidations made before `initgcinvals` accounted for the proposals stored before the upgrade.
          struct [[eosio::table]] invalidation {
-            name         account;
-            time_point   last_invalidation_time;
+            name                                        account;
+            time_point                                  last_invalidation_time;
+            eosio::binary_extension<time_point_sec>     expiration_horizon;
 
             uint64_t primary_key() const { return account.value; }
          };
 
          typedef eosio::multi_index< "invals"_n, invalidation > invalidations;
+
+         // Latest expiration of the transactions proposed before expirations were tracked in the `expiries` table,
+         // set once together with `gc_enabled` by `initgcinvals`
+         struct [[eosio::table("state")]] msig_state {
+            time_point_sec   legacy_expiration;
+            bool             gc_enabled = false;
+         };
+
+         typedef eosio::singleton< "state"_n, msig_state > msig_state_singleton;
+
+         // Invalidation times of the distinct actors approving a proposal, read once per actor by `exec`
+         struct invalidation_cache {
+            name                                      self;
+            std::vector<name>                         actors;
+            std::vector<std::optional<time_point>>    invalidation_times;
+
+            explicit invalidation_cache( const name& self ) : self(self) {}
+            void add( const name& actor );
+            void resolve();
+            const std::optional<time_point>& get( const name& actor )const;
+         };
+
+         static bool approval_less( const approval& a, const approval& b );
+         static std::vector<approval>::const_iterator find_approval( const approvals_info& apps, const std::vector<approval>& list,
+                                                                     const permission_level& level );
+         static void insert_approval( approvals_info& apps, std::vector<approval>& list, const approval& app );
+         void approve_proposal( const name& proposer, const name& proposal_name, const permission_level& level,
+                                const std::optional<eosio::checksum256>& proposal_hash );
+         void create_proposal( const name& proposer, const name& proposal_name, const std::vector<permission_level>& requested,
+                               const char* packed_trx, size_t size );
+         void erase_proposal( proposals& proptable, const proposal& prop, const name& proposer );
+         void remove_proposal_expiry( const name& proposer, const name& proposal_name );
+         void exec_proposal( const name& proposer, const name& proposal_name, const name& executer, bool inline_exec );
+         void send_inline_transaction( const std::vector<char>& packed_trx )const;
    };
    /** @}*/ // end of @defgroup eosiomsig eosio.msig
 } /// namespace eosio
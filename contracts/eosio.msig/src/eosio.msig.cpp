@@ -1,9 +1,13 @@
 #include <eosio/action.hpp>
 #include <eosio/crypto.hpp>
 #include <eosio/permission.hpp>
+#include <eosio/privileged.hpp>
 
 #include <eosio.msig/eosio.msig.hpp>
 
+#include <algorithm>
+#include <tuple>
+
 namespace eosio {
 
 void multisig::propose( ignore<name> proposer,
@@ -14,70 +18,106 @@ void multisig::propose( ignore<name> proposer,
    name _proposer;
    name _proposal_name;
    std::vector<permission_level> _requested;
-   transaction_header _trx_header;
 
    _ds >> _proposer >> _proposal_name >> _requested;
 
    const char* trx_pos = _ds.pos();
    size_t size    = _ds.remaining();
-   _ds >> _trx_header;
 
    require_auth( _proposer );
-   check( _trx_header.expiration >= eosio::time_point_sec(current_time_point()), "transaction expired" );
-   //check( trx_header.actions.size() > 0, "transaction must have at least one action" );
+   create_proposal( _proposer, _proposal_name, _requested, trx_pos, size );
+}
 
-   proposals proptable( get_self(), _proposer.value );
-   check( proptable.find( _proposal_name.value ) == proptable.end(), "proposal with the same name exists" );
+void multisig::propbegin( name proposer, name proposal_name, std::vector<permission_level> requested ) {
+   require_auth( proposer );
 
-   auto packed_requested = pack(_requested);
-   auto res =  check_transaction_authorization(
-                  trx_pos, size,
-                  (const char*)0, 0,
-                  packed_requested.data(), packed_requested.size()
-               );
+   proposals proptable( get_self(), proposer.value );
+   check( proptable.find( proposal_name.value ) == proptable.end(), "proposal with the same name exists" );
 
-   check( res > 0, "transaction authorization failed" );
+   uploads upltable( get_self(), proposer.value );
+   auto it = upltable.find( proposal_name.value );
+   if ( it == upltable.end() ) {
+      upltable.emplace( proposer, [&]( auto& u ) {
+         u.proposal_name = proposal_name;
+         u.requested     = std::move(requested);
+      });
+   } else {
+      // restarts an upload of the same name
+      upltable.modify( it, proposer, [&]( auto& u ) {
+         u.requested = std::move(requested);
+         u.packed_transaction.clear();
+      });
+   }
+}
 
-   std::vector<char> pkd_trans;
-   pkd_trans.resize(size);
-   memcpy((char*)pkd_trans.data(), trx_pos, size);
-   proptable.emplace( _proposer, [&]( auto& prop ) {
-      prop.proposal_name       = _proposal_name;
-      prop.packed_transaction  = pkd_trans;
-   });
+void multisig::propappend( name proposer, name proposal_name, const std::vector<char>& chunk ) {
+   require_auth( proposer );
+   check( !chunk.empty(), "chunk is empty" );
 
-   approvals apptable( get_self(), _proposer.value );
-   apptable.emplace( _proposer, [&]( auto& a ) {
-      a.proposal_name       = _proposal_name;
-      a.requested_approvals.reserve( _requested.size() );
-      for ( auto& level : _requested ) {
-         a.requested_approvals.push_back( approval{ level, time_point{ microseconds{0} } } );
-      }
+   uploads upltable( get_self(), proposer.value );
+   auto& upl = upltable.get( proposal_name.value, "upload not found" );
+   upltable.modify( upl, proposer, [&]( auto& u ) {
+      u.packed_transaction.insert( u.packed_transaction.end(), chunk.begin(), chunk.end() );
    });
 }
 
+void multisig::propfinalize( name proposer, name proposal_name ) {
+   require_auth( proposer );
+
+   uploads upltable( get_self(), proposer.value );
+   auto& upl = upltable.get( proposal_name.value, "upload not found" );
+   check( !upl.packed_transaction.empty(), "no transaction uploaded" );
+
+   create_proposal( proposer, proposal_name, upl.requested, upl.packed_transaction.data(), upl.packed_transaction.size() );
+   upltable.erase( upl );
+}
+
 void multisig::approve( name proposer, name proposal_name, permission_level level,
                         const eosio::binary_extension<eosio::checksum256>& proposal_hash )
 {
    require_auth( level );
 
+   approve_proposal( proposer, proposal_name, level,
+                     proposal_hash ? std::optional<eosio::checksum256>( *proposal_hash ) : std::nullopt );
+}
+
+void multisig::approvemany( permission_level level, const std::vector<proposal_approval>& proposals ) {
+   require_auth( level );
+   check( !proposals.empty(), "no proposals specified" );
+
+   for ( const auto& p : proposals ) {
+      approve_proposal( p.proposer, p.proposal_name, level, p.proposal_hash );
+   }
+}
+
+void multisig::approve_proposal( const name& proposer, const name& proposal_name, const permission_level& level,
+                                 const std::optional<eosio::checksum256>& proposal_hash )
+{
    if( proposal_hash ) {
-      proposals proptable( get_self(), proposer.value );
-      auto& prop = proptable.get( proposal_name.value, "proposal not found" );
-      assert_sha256( prop.packed_transaction.data(), prop.packed_transaction.size(), *proposal_hash );
+      proposal_expiries expiry_table( get_self(), get_self().value );
+      auto proposal_idx = expiry_table.get_index<"byproposal"_n>();
+      auto expiry_it = proposal_idx.find( proposal_expiry::proposal_key( proposer, proposal_name ) );
+      // the transaction is only loaded and rehashed if it does not match the digest stored at propose time,
+      // so that the mismatch is reported by assert_sha256 as before; older proposals have no expiry row
+      if( expiry_it == proposal_idx.end() || expiry_it->trx_hash != *proposal_hash ) {
+         proposals proptable( get_self(), proposer.value );
+         auto& prop = proptable.get( proposal_name.value, "proposal not found" );
+         assert_sha256( prop.packed_transaction.data(), prop.packed_transaction.size(), *proposal_hash );
+      }
    }
 
    approvals apptable( get_self(), proposer.value );
    auto apps_it = apptable.find( proposal_name.value );
    if ( apps_it != apptable.end() ) {
-      auto itr = std::find_if( apps_it->requested_approvals.begin(), apps_it->requested_approvals.end(), [&](const approval& a) { return a.level == level; } );
+      auto itr = find_approval( *apps_it, apps_it->requested_approvals, level );
       check( itr != apps_it->requested_approvals.end(), "approval is not on the list of requested approvals" );
 
       apptable.modify( apps_it, proposer, [&]( auto& a ) {
-            a.provided_approvals.push_back( approval{ level, current_time_point() } );
             a.requested_approvals.erase( itr );
+            insert_approval( a, a.provided_approvals, approval{ level, current_time_point() } );
          });
    } else {
+#if LEGACY_APPROVALS_FALLBACK
       old_approvals old_apptable( get_self(), proposer.value );
       auto& apps = old_apptable.get( proposal_name.value, "proposal not found" );
 
@@ -88,6 +128,9 @@ void multisig::approve( name proposer, name proposal_name, permission_level leve
             a.provided_approvals.push_back( level );
             a.requested_approvals.erase( itr );
          });
+#else
+      check( false, "proposal not found" );
+#endif
    }
 }
 
@@ -97,13 +140,14 @@ void multisig::unapprove( name proposer, name proposal_name, permission_level le
    approvals apptable( get_self(), proposer.value );
    auto apps_it = apptable.find( proposal_name.value );
    if ( apps_it != apptable.end() ) {
-      auto itr = std::find_if( apps_it->provided_approvals.begin(), apps_it->provided_approvals.end(), [&](const approval& a) { return a.level == level; } );
+      auto itr = find_approval( *apps_it, apps_it->provided_approvals, level );
       check( itr != apps_it->provided_approvals.end(), "no approval previously granted" );
       apptable.modify( apps_it, proposer, [&]( auto& a ) {
-            a.requested_approvals.push_back( approval{ level, current_time_point() } );
             a.provided_approvals.erase( itr );
+            insert_approval( a, a.requested_approvals, approval{ level, current_time_point() } );
          });
    } else {
+#if LEGACY_APPROVALS_FALLBACK
       old_approvals old_apptable( get_self(), proposer.value );
       auto& apps = old_apptable.get( proposal_name.value, "proposal not found" );
       auto itr = std::find( apps.provided_approvals.begin(), apps.provided_approvals.end(), level );
@@ -112,6 +156,9 @@ void multisig::unapprove( name proposer, name proposal_name, permission_level le
             a.requested_approvals.push_back( level );
             a.provided_approvals.erase( itr );
          });
+#else
+      check( false, "proposal not found" );
+#endif
    }
 }
 
@@ -119,89 +166,345 @@ void multisig::cancel( name proposer, name proposal_name, name canceler ) {
    require_auth( canceler );
 
    proposals proptable( get_self(), proposer.value );
-   auto& prop = proptable.get( proposal_name.value, "proposal not found" );
+   auto prop_it = proptable.find( proposal_name.value );
+   if ( prop_it == proptable.end() ) {
+      // an unfinished upload can only be dropped by its proposer
+      uploads upltable( get_self(), proposer.value );
+      auto& upl = upltable.get( proposal_name.value, "proposal not found" );
+      check( canceler == proposer, "only the proposer can cancel an upload" );
+      upltable.erase( upl );
+      return;
+   }
+   auto& prop = *prop_it;
 
    if( canceler != proposer ) {
       check( unpack<transaction_header>( prop.packed_transaction ).expiration < eosio::time_point_sec(current_time_point()), "cannot cancel until expiration" );
    }
-   proptable.erase(prop);
+   erase_proposal( proptable, prop, proposer );
+}
 
-   //remove from new table
-   approvals apptable( get_self(), proposer.value );
-   auto apps_it = apptable.find( proposal_name.value );
-   if ( apps_it != apptable.end() ) {
-      apptable.erase(apps_it);
-   } else {
-      old_approvals old_apptable( get_self(), proposer.value );
-      auto apps_it = old_apptable.find( proposal_name.value );
-      check( apps_it != old_apptable.end(), "proposal not found" );
-      old_apptable.erase(apps_it);
+void multisig::gcexpired( uint32_t max ) {
+   check( max > 0, "max must be positive" );
+
+   const time_point_sec now = eosio::time_point_sec(current_time_point());
+   proposal_expiries expiry_table( get_self(), get_self().value );
+   auto expiry_idx = expiry_table.get_index<"byexpiration"_n>();
+   for ( uint32_t i = 0; i < max; ++i ) {
+      auto it = expiry_idx.begin();
+      if ( it == expiry_idx.end() || now <= it->expiration ) {
+         break;
+      }
+      const name proposer = it->proposer;
+      proposals proptable( get_self(), proposer.value );
+      auto& prop = proptable.get( it->proposal_name.value, "proposal not found" );
+      // erases the expiry row as well
+      erase_proposal( proptable, prop, proposer );
    }
 }
 
 void multisig::exec( name proposer, name proposal_name, name executer ) {
    require_auth( executer );
+   exec_proposal( proposer, proposal_name, executer, false );
+}
+
+void multisig::execinline( name proposer, name proposal_name, name executer ) {
+   require_auth( executer );
+   exec_proposal( proposer, proposal_name, executer, true );
+}
 
+void multisig::exec_proposal( const name& proposer, const name& proposal_name, const name& executer, bool inline_exec ) {
    proposals proptable( get_self(), proposer.value );
    auto& prop = proptable.get( proposal_name.value, "proposal not found" );
+   const auto& packed_trx = prop.packed_transaction;
    transaction_header trx_header;
-   datastream<const char*> ds( prop.packed_transaction.data(), prop.packed_transaction.size() );
+   datastream<const char*> ds( packed_trx.data(), packed_trx.size() );
    ds >> trx_header;
    check( trx_header.expiration >= eosio::time_point_sec(current_time_point()), "transaction expired" );
 
    approvals apptable( get_self(), proposer.value );
    auto apps_it = apptable.find( proposal_name.value );
    std::vector<permission_level> approvals;
-   invalidations inv_table( get_self(), get_self().value );
+   invalidation_cache inv_cache( get_self() );
    if ( apps_it != apptable.end() ) {
+      for ( auto& p : apps_it->provided_approvals ) {
+         inv_cache.add( p.level.actor );
+      }
+      inv_cache.resolve();
       approvals.reserve( apps_it->provided_approvals.size() );
       for ( auto& p : apps_it->provided_approvals ) {
-         auto it = inv_table.find( p.level.actor.value );
-         if ( it == inv_table.end() || it->last_invalidation_time < p.time ) {
+         const auto& inv_time = inv_cache.get( p.level.actor );
+         if ( !inv_time || *inv_time < p.time ) {
             approvals.push_back(p.level);
          }
       }
       apptable.erase(apps_it);
    } else {
+#if LEGACY_APPROVALS_FALLBACK
       old_approvals old_apptable( get_self(), proposer.value );
       auto& apps = old_apptable.get( proposal_name.value, "proposal not found" );
       for ( auto& level : apps.provided_approvals ) {
-         auto it = inv_table.find( level.actor.value );
-         if ( it == inv_table.end() ) {
+         inv_cache.add( level.actor );
+      }
+      inv_cache.resolve();
+      for ( auto& level : apps.provided_approvals ) {
+         if ( !inv_cache.get( level.actor ) ) {
             approvals.push_back( level );
          }
       }
       old_apptable.erase(apps);
+#else
+      check( false, "proposal not found" );
+#endif
    }
    auto packed_provided_approvals = pack(approvals);
    auto res =  check_transaction_authorization(
-                  prop.packed_transaction.data(), prop.packed_transaction.size(),
+                  packed_trx.data(), packed_trx.size(),
                   (const char*)0, 0,
                   packed_provided_approvals.data(), packed_provided_approvals.size()
                );
 
    check( res > 0, "transaction authorization failed" );
 
-   send_deferred( (uint128_t(proposer.value) << 64) | proposal_name.value, executer,
-                  prop.packed_transaction.data(), prop.packed_transaction.size() );
+   if ( inline_exec ) {
+      send_inline_transaction( packed_trx );
+   } else {
+      send_deferred( (uint128_t(proposer.value) << 64) | proposal_name.value, executer,
+                     packed_trx.data(), packed_trx.size() );
+   }
 
+   remove_proposal_expiry( proposer, proposal_name );
    proptable.erase(prop);
 }
 
+void multisig::migrateapps( const std::vector<name>& proposers, uint32_t max ) {
+   require_auth( get_self() );
+   check( max > 0, "max must be positive" );
+
+   uint32_t migrated = 0;
+   for ( const auto& proposer : proposers ) {
+      old_approvals old_apptable( get_self(), proposer.value );
+      approvals apptable( get_self(), proposer.value );
+      for ( auto it = old_apptable.begin(); it != old_apptable.end() && migrated < max; ++migrated ) {
+         check( apptable.find( it->proposal_name.value ) == apptable.end(), "approvals already migrated" );
+         apptable.emplace( get_self(), [&]( auto& a ) {
+            a.version       = 2;
+            a.proposal_name = it->proposal_name;
+            // legacy approvals have no time; a provided approval is invalidated by any invalidation of its actor, as before
+            for ( const auto& level : it->requested_approvals ) {
+               a.requested_approvals.push_back( approval{ level, time_point{ microseconds{0} } } );
+            }
+            for ( const auto& level : it->provided_approvals ) {
+               a.provided_approvals.push_back( approval{ level, time_point{ microseconds{0} } } );
+            }
+            std::sort( a.requested_approvals.begin(), a.requested_approvals.end(), approval_less );
+            std::sort( a.provided_approvals.begin(), a.provided_approvals.end(), approval_less );
+         });
+         it = old_apptable.erase( it );
+      }
+   }
+}
+
 void multisig::invalidate( name account ) {
    require_auth( account );
+   // the invalidation can be pruned once every proposal that may hold an approval it invalidates has expired,
+   // which is not known until the proposals stored before the upgrade are accounted for by initgcinvals
+   msig_state_singleton state( get_self(), get_self().value );
+   const auto st = state.get_or_default();
+   std::optional<time_point_sec> horizon;
+   if ( st.gc_enabled ) {
+      // only the proposals stored now can hold such an approval, so cancelled and executed ones do not count
+      horizon = st.legacy_expiration;
+      proposal_expiries expiry_table( get_self(), get_self().value );
+      auto expiry_idx = expiry_table.get_index<"byexpiration"_n>();
+      if ( expiry_idx.begin() != expiry_idx.end() ) {
+         horizon = std::max( *horizon, expiry_idx.rbegin()->expiration );
+      }
+   }
+
    invalidations inv_table( get_self(), get_self().value );
    auto it = inv_table.find( account.value );
    if ( it == inv_table.end() ) {
       inv_table.emplace( account, [&](auto& i) {
             i.account = account;
             i.last_invalidation_time = current_time_point();
+            if ( horizon ) {
+               i.expiration_horizon.emplace( *horizon );
+            }
          });
    } else {
       inv_table.modify( it, account, [&](auto& i) {
             i.last_invalidation_time = current_time_point();
+            if ( horizon ) {
+               i.expiration_horizon.emplace( *horizon );
+            } else {
+               i.expiration_horizon.reset();
+            }
          });
    }
 }
 
+void multisig::initgcinvals( time_point_sec max_expiration ) {
+   require_auth( get_self() );
+
+   msig_state_singleton state( get_self(), get_self().value );
+   auto st = state.get_or_default();
+   check( !st.gc_enabled, "invalidations garbage collection is already initialized" );
+   st.legacy_expiration = max_expiration;
+   st.gc_enabled = true;
+   state.set( st, get_self() );
+}
+
+void multisig::gcinvals( name lower_bound, uint32_t max ) {
+   check( max > 0, "max must be positive" );
+
+   const time_point_sec now = eosio::time_point_sec(current_time_point());
+   invalidations inv_table( get_self(), get_self().value );
+   auto it = inv_table.lower_bound( lower_bound.value );
+   for ( uint32_t i = 0; i < max && it != inv_table.end(); ++i ) {
+      if ( it->expiration_horizon && *it->expiration_horizon < now ) {
+         it = inv_table.erase( it );
+      } else {
+         ++it;
+      }
+   }
+}
+
+void multisig::invalidation_cache::add( const name& actor ) {
+   actors.push_back( actor );
+}
+
+void multisig::invalidation_cache::resolve() {
+   std::sort( actors.begin(), actors.end() );
+   actors.erase( std::unique( actors.begin(), actors.end() ), actors.end() );
+   invalidation_times.reserve( actors.size() );
+   invalidations inv_table( self, self.value );
+   for ( const auto& actor : actors ) {
+      auto it = inv_table.find( actor.value );
+      invalidation_times.push_back( it != inv_table.end() ? std::optional<time_point>( it->last_invalidation_time ) : std::nullopt );
+   }
+}
+
+const std::optional<time_point>& multisig::invalidation_cache::get( const name& actor )const {
+   auto it = std::lower_bound( actors.begin(), actors.end(), actor );
+   check( it != actors.end() && *it == actor, "actor was not resolved" );
+   return invalidation_times[ it - actors.begin() ];
+}
+
+void multisig::create_proposal( const name& proposer, const name& proposal_name, const std::vector<permission_level>& requested,
+                                const char* packed_trx, size_t size )
+{
+   transaction_header trx_header;
+   datastream<const char*> ds( packed_trx, size );
+   ds >> trx_header;
+   check( trx_header.expiration >= eosio::time_point_sec(current_time_point()), "transaction expired" );
+   //check( trx_header.actions.size() > 0, "transaction must have at least one action" );
+
+   proposals proptable( get_self(), proposer.value );
+   check( proptable.find( proposal_name.value ) == proptable.end(), "proposal with the same name exists" );
+
+   auto packed_requested = pack(requested);
+   auto res =  check_transaction_authorization(
+                  packed_trx, size,
+                  (const char*)0, 0,
+                  packed_requested.data(), packed_requested.size()
+               );
+
+   check( res > 0, "transaction authorization failed" );
+
+   proptable.emplace( proposer, [&]( auto& prop ) {
+      prop.proposal_name       = proposal_name;
+      prop.packed_transaction.resize( size );
+      memcpy( prop.packed_transaction.data(), packed_trx, size );
+   });
+
+   proposal_expiries expiry_table( get_self(), get_self().value );
+   expiry_table.emplace( proposer, [&]( auto& e ) {
+      e.id            = expiry_table.available_primary_key();
+      e.proposer      = proposer;
+      e.proposal_name = proposal_name;
+      e.expiration    = trx_header.expiration;
+      e.trx_hash      = sha256( packed_trx, size );
+   });
+
+   approvals apptable( get_self(), proposer.value );
+   apptable.emplace( proposer, [&]( auto& a ) {
+      a.version             = 2;
+      a.proposal_name       = proposal_name;
+      a.requested_approvals.reserve( requested.size() );
+      for ( auto& level : requested ) {
+         a.requested_approvals.push_back( approval{ level, time_point{ microseconds{0} } } );
+      }
+      std::sort( a.requested_approvals.begin(), a.requested_approvals.end(), approval_less );
+   });
+}
+
+bool multisig::approval_less( const approval& a, const approval& b ) {
+   return std::tie( a.level.actor, a.level.permission ) < std::tie( b.level.actor, b.level.permission );
+}
+
+std::vector<multisig::approval>::const_iterator multisig::find_approval( const approvals_info& apps, const std::vector<approval>& list,
+                                                                          const permission_level& level )
+{
+   if ( apps.version < 2 ) {
+      return std::find_if( list.begin(), list.end(), [&](const approval& a) { return a.level == level; } );
+   }
+   const approval key{ level, time_point{} };
+   auto itr = std::lower_bound( list.begin(), list.end(), key, approval_less );
+   return ( itr != list.end() && itr->level == level ) ? itr : list.end();
+}
+
+void multisig::insert_approval( approvals_info& apps, std::vector<approval>& list, const approval& app ) {
+   // rows of version 1 are sorted the first time they are modified
+   if ( apps.version < 2 ) {
+      std::sort( apps.requested_approvals.begin(), apps.requested_approvals.end(), approval_less );
+      std::sort( apps.provided_approvals.begin(), apps.provided_approvals.end(), approval_less );
+      apps.version = 2;
+   }
+   list.insert( std::upper_bound( list.begin(), list.end(), app, approval_less ), app );
+}
+
+void multisig::erase_proposal( proposals& proptable, const proposal& prop, const name& proposer ) {
+   const name proposal_name = prop.proposal_name;
+   remove_proposal_expiry( proposer, proposal_name );
+   proptable.erase(prop);
+
+   //remove from new table
+   approvals apptable( get_self(), proposer.value );
+   auto apps_it = apptable.find( proposal_name.value );
+   if ( apps_it != apptable.end() ) {
+      apptable.erase(apps_it);
+   } else {
+#if LEGACY_APPROVALS_FALLBACK
+      old_approvals old_apptable( get_self(), proposer.value );
+      auto apps_it = old_apptable.find( proposal_name.value );
+      check( apps_it != old_apptable.end(), "proposal not found" );
+      old_apptable.erase(apps_it);
+#else
+      check( false, "proposal not found" );
+#endif
+   }
+}
+
+void multisig::remove_proposal_expiry( const name& proposer, const name& proposal_name ) {
+   proposal_expiries expiry_table( get_self(), get_self().value );
+   auto proposal_idx = expiry_table.get_index<"byproposal"_n>();
+   auto it = proposal_idx.find( proposal_expiry::proposal_key( proposer, proposal_name ) );
+   // proposals made before the expiry table was added are not indexed
+   if ( it != proposal_idx.end() ) {
+      proposal_idx.erase( it );
+   }
+}
+
+void multisig::send_inline_transaction( const std::vector<char>& packed_trx )const {
+   // inline actions of a privileged contract are not checked against their authorizations,
+   // which have been checked against the provided approvals instead
+   check( is_privileged( get_self() ), "inline execution requires a privileged contract" );
+   const auto trx = unpack<transaction>( packed_trx );
+   check( trx.delay_sec.value == 0, "inline execution requires a transaction without delay" );
+   check( trx.context_free_actions.empty(), "inline execution does not support context-free actions" );
+   for ( const auto& act : trx.actions ) {
+      act.send();
+   }
+}
+
 } /// namespace eosio
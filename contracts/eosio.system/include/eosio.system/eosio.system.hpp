@@ -24,6 +24,15 @@
 // be set to 0.
 #define CHANNEL_RAM_AND_NAMEBID_FEES_TO_REX 1
 
+#ifdef ROUTE_RAM_FEES_DIRECTLY_TO_REX
+#undef ROUTE_RAM_FEES_DIRECTLY_TO_REX
+#endif
+// ROUTE_RAM_FEES_DIRECTLY_TO_REX macro determines whether ramfee proceeds channeled to REX pool are
+// transferred by the payer directly to eosio.rex, instead of first going through eosio.ramfee.
+// Return pool accounting is the same in both modes. In order to route fees through eosio.ramfee,
+// the macro must be set to 0.
+#define ROUTE_RAM_FEES_DIRECTLY_TO_REX 1
+
 namespace eosiosystem {
 
    using eosio::asset;
@@ -71,12 +80,15 @@ namespace eosiosystem {
    static constexpr int64_t  ram_gift_bytes        = 1400;
    static constexpr int64_t  min_pervote_daily_pay = 100'0000;
    static constexpr uint32_t refund_delay_sec      = 3 * seconds_per_day;
+   static constexpr uint16_t max_closebids_visits  = 500; // auctions visited by one closebids, closed or skipped
 
    static constexpr int64_t  inflation_precision           = 100;     // 2 decimals
    static constexpr int64_t  default_annual_rate           = 500;     // 5% annual rate
    static constexpr int64_t  pay_factor_precision          = 10000;
    static constexpr int64_t  default_inflation_pay_factor  = 50000;   // producers pay share = 10000 / 50000 = 20% of the inflation
    static constexpr int64_t  default_votepay_factor        = 40000;   // per-block pay share = 10000 / 40000 = 25% of the producer pay
+   static constexpr int64_t  continuous_rate_precision     = 1'000'000'000; // fixed-point precision of the continuous rate, from revision 3
+   static constexpr int64_t  inflation_accrual_interval    = useconds_per_hour; // inflation is accrued at most once per hour, from revision 3
 
    /**
     * eosio.system contract
@@ -120,6 +132,8 @@ namespace eosiosystem {
                              > name_bid_table;
 
    typedef eosio::multi_index< "bidrefunds"_n, bid_refund > bid_refund_table;
+   // Bid refunds owed to a bidder that was outbid, accumulated over all names in a single row
+   typedef eosio::multi_index< "bidledger"_n, bid_refund > bid_refund_ledger_table;
 
    // Defines new global state parameters.
    struct [[eosio::table("global"), eosio::contract("eosio.system")]] eosio_global_state : eosio::blockchain_parameters {
@@ -171,20 +185,56 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate) )
    };
 
+   // Inflation accrued by `onblock` from revision 3 that is not issued yet, split as it will be paid out
+   struct unissued_inflation {
+      int64_t  to_savings       = 0;
+      int64_t  to_per_block_pay = 0;
+      int64_t  to_per_vote_pay  = 0;
+
+      int64_t total()const { return to_savings + to_per_block_pay + to_per_vote_pay; }
+
+      EOSLIB_SERIALIZE( unissued_inflation, (to_savings)(to_per_block_pay)(to_per_vote_pay) )
+   };
+
    // Defines new global state parameters to store inflation rate and distribution
    struct [[eosio::table("global4"), eosio::contract("eosio.system")]] eosio_global_state4 {
       eosio_global_state4() { }
       double   continuous_rate;
       int64_t  inflation_pay_factor;
       int64_t  votepay_factor;
+      eosio::binary_extension<unissued_inflation>  unissued; // added in revision 3
 
-      EOSLIB_SERIALIZE( eosio_global_state4, (continuous_rate)(inflation_pay_factor)(votepay_factor) )
+      EOSLIB_SERIALIZE( eosio_global_state4, (continuous_rate)(inflation_pay_factor)(votepay_factor)(unissued) )
    };
 
    inline eosio::block_signing_authority convert_to_block_signing_authority( const eosio::public_key& producer_key ) {
       return eosio::block_signing_authority_v0{ .threshold = 1, .keys = {{producer_key, 1}} };
    }
 
+   // Votepay checkpoint of a producer: the votepay share accumulated up to the last update of the producer's votes.
+   // From revision 4 it is moved from the producers2 table into the producer's row of the producers table by the
+   // actions the producer authorizes (regproducer, regproducer2 and claimrewards), or by migratevpay at the expense
+   // of the contract, so that updating the votes of a producer and its votepay share takes a single row write.
+   // Deactivating a producer moves it back to producers2.
+   struct producer_votepay_checkpoint {
+      double          votepay_share = 0;
+      time_point      last_votepay_share_update;
+
+      // Accrues `shares_rate` per second since the last update and returns the new votepay share.
+      double update( const time_point& ct, double shares_rate, bool reset_to_zero ) {
+         double delta_votepay_share = 0.0;
+         if( shares_rate > 0.0 && ct > last_votepay_share_update ) {
+            delta_votepay_share = shares_rate * double( (ct - last_votepay_share_update).count() / 1E6 ); // cannot be negative
+         }
+         const double new_votepay_share = votepay_share + delta_votepay_share;
+         votepay_share             = reset_to_zero ? 0.0 : new_votepay_share;
+         last_votepay_share_update = ct;
+         return new_votepay_share;
+      }
+
+      EOSLIB_SERIALIZE( producer_votepay_checkpoint, (votepay_share)(last_votepay_share_update) )
+   };
+
    // Defines `producer_info` structure to be stored in `producer_info` table, added after version 1.0
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info {
       name                                                     owner;
@@ -196,11 +246,12 @@ namespace eosiosystem {
       time_point                                               last_claim_time;
       uint16_t                                                 location = 0;
       eosio::binary_extension<eosio::block_signing_authority>  producer_authority; // added in version 1.9.0
+      eosio::binary_extension<producer_votepay_checkpoint>     votepay_checkpoint; // added in revision 4
 
       uint64_t primary_key()const { return owner.value;                             }
       double   by_votes()const    { return is_active ? -total_votes : total_votes;  }
       bool     active()const      { return is_active;                               }
-      void     deactivate()       { producer_key = public_key(); producer_authority.reset(); is_active = false; }
+      void     deactivate()       { producer_key = public_key(); producer_authority.reset(); votepay_checkpoint.reset(); is_active = false; }
 
       eosio::block_signing_authority get_producer_authority()const {
          if( producer_authority.has_value() ) {
@@ -223,6 +274,8 @@ namespace eosiosystem {
       // way and increasing its serialized size is not acceptable in that context.
       // So, a custom serialization is defined to handle the binary_extension producer_authority
       // field in the desired way. (Note: v1.9.0 did not have this custom serialization behavior.)
+      // The votepay_checkpoint field follows producer_authority and is only ever set on rows that have a producer
+      // authority; deactivate clears both.
 
       template<typename DataStream>
       friend DataStream& operator << ( DataStream& ds, const producer_info& t ) {
@@ -237,7 +290,11 @@ namespace eosiosystem {
 
          if( !t.producer_authority.has_value() ) return ds;
 
-         return ds << t.producer_authority;
+         ds << t.producer_authority;
+
+         if( !t.votepay_checkpoint.has_value() ) return ds;
+
+         return ds << t.votepay_checkpoint;
       }
 
       template<typename DataStream>
@@ -250,7 +307,8 @@ namespace eosiosystem {
                    >> t.unpaid_blocks
                    >> t.last_claim_time
                    >> t.location
-                   >> t.producer_authority;
+                   >> t.producer_authority
+                   >> t.votepay_checkpoint;
       }
    };
 
@@ -266,6 +324,20 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( producer_info2, (owner)(votepay_share)(last_votepay_share_update) )
    };
 
+   // Block counter. Stores the blocks produced by a producer that have not yet been added to its
+   // `unpaid_blocks`. From revision 2, `onblock` only writes to this table between producer schedule
+   // updates; the counts are folded into the producers table and the global state once a minute
+   // and before rewards are claimed.
+   struct [[eosio::table, eosio::contract("eosio.system")]] producer_block_count {
+      name            producer;
+      uint32_t        unpaid_blocks = 0;
+
+      uint64_t primary_key()const { return producer.value; }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( producer_block_count, (producer)(unpaid_blocks) )
+   };
+
    // Voter info. Voter info stores information about the voter:
    // - `owner` the voter
    // - `proxy` the proxy set by the voter, if any
@@ -313,6 +385,8 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "producers2"_n, producer_info2 > producers_table2;
 
+   typedef eosio::multi_index< "blockcounts"_n, producer_block_count > producer_block_count_table;
+
 
    typedef eosio::singleton< "global"_n, eosio_global_state >   global_state_singleton;
 
@@ -350,6 +424,24 @@ namespace eosiosystem {
 
    };
 
+   // Every receiver 'to' has a scope/table that uses every delegator 'from' as the primary key.
+   // Rows mirror the `delband` rows of the delegators, so that all delegations to an account
+   // can be read from its own scope. Delegations made before this table was added are mirrored
+   // when they are next changed, or by `fillinbound`.
+   struct [[eosio::table, eosio::contract("eosio.system")]] inbound_delegation {
+      name          from;
+      name          to;
+      asset         net_weight;
+      asset         cpu_weight;
+
+      bool is_empty()const { return net_weight.amount == 0 && cpu_weight.amount == 0; }
+      uint64_t  primary_key()const { return from.value; }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( inbound_delegation, (from)(to)(net_weight)(cpu_weight) )
+
+   };
+
    struct [[eosio::table, eosio::contract("eosio.system")]] refund_request {
       name            owner;
       time_point_sec  request_time;
@@ -363,10 +455,38 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( refund_request, (owner)(request_time)(net_amount)(cpu_amount) )
    };
 
+   // Refund queue entry, one per pending refund request. Entries are ordered by `request_time`
+   // so that `procrefunds` can pay out all matured refunds without a deferred transaction per owner.
+   struct [[eosio::table, eosio::contract("eosio.system")]] refund_queue_entry {
+      name            owner;
+      time_point_sec  request_time;
+
+      uint64_t  primary_key()const { return owner.value; }
+      uint64_t  by_request_time()const { return request_time.utc_seconds; }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( refund_queue_entry, (owner)(request_time) )
+   };
+
+   // A single entry of a batch (un)delegation, defined by:
+   // - the `receiver` account to whose benefit tokens are staked
+   // - the `net_quantity` of tokens staked for NET bandwidth
+   // - the `cpu_quantity` of tokens staked for CPU bandwidth
+   struct bandwidth_delegation {
+      name    receiver;
+      asset   net_quantity;
+      asset   cpu_quantity;
+
+      EOSLIB_SERIALIZE( bandwidth_delegation, (receiver)(net_quantity)(cpu_quantity) )
+   };
 
    typedef eosio::multi_index< "userres"_n, user_resources >      user_resources_table;
    typedef eosio::multi_index< "delband"_n, delegated_bandwidth > del_bandwidth_table;
+   typedef eosio::multi_index< "delbandin"_n, inbound_delegation > inbound_delegation_table;
    typedef eosio::multi_index< "refunds"_n, refund_request >      refunds_table;
+   typedef eosio::multi_index< "refundqueue"_n, refund_queue_entry,
+                               indexed_by<"bytime"_n, const_mem_fun<refund_queue_entry, uint64_t, &refund_queue_entry::by_request_time>>
+                             > refund_queue_table;
 
    // `rex_pool` structure underlying the rex pool table. A rex pool table entry is defined by:
    // - `version` defaulted to zero,
@@ -546,6 +666,7 @@ namespace eosiosystem {
          rex_fund_table           _rexfunds;
          rex_balance_table        _rexbalance;
          rex_order_table          _rexorders;
+         bool                     _globals_modified = true;
 
       public:
          static constexpr eosio::name active_permission{"active"_n};
@@ -910,10 +1031,9 @@ namespace eosiosystem {
           * left to delegate.
           * This will cause an immediate reduction in net/cpu bandwidth of the
           * receiver.
-          * A transaction is scheduled to send the tokens back to `from` after
-          * the staking period has passed. If existing transaction is scheduled, it
-          * will be canceled and a new transaction issued that has the combined
-          * undelegated amount.
+          * A refund request is queued to send the tokens back to `from` after
+          * the staking period has passed. If a refund request is already pending,
+          * the undelegated amount is added to it and its timer is reset.
           * The `from` account loses voting power as a result of this call and
           * all producer tallies are updated.
           *
@@ -924,17 +1044,55 @@ namespace eosiosystem {
           * @param unstake_net_quantity - tokens to be unstaked from NET bandwidth,
           * @param unstake_cpu_quantity - tokens to be unstaked from CPU bandwidth,
           *
-          * @post Unstaked tokens are transferred to `from` liquid balance via a
-          *    deferred transaction with a delay of 3 days.
+          * @post Unstaked tokens are refundable to `from` liquid balance after a delay of 3 days,
+          *    through the `refund` or `procrefunds` actions.
           * @post If called during the delay period of a previous `undelegatebw`
-          *    action, pending action is canceled and timer is reset.
+          *    action, pending refund timer is reset.
           * @post All producers `from` account has voted for will have their votes updated immediately.
-          * @post Bandwidth and storage for the deferred transaction are billed to `from`.
+          * @post Storage for the refund request and its refund queue entry is billed to `from`.
           */
          [[eosio::action]]
          void undelegatebw( const name& from, const name& receiver,
                             const asset& unstake_net_quantity, const asset& unstake_cpu_quantity );
 
+         /**
+          * Delegate many action, stakes SYS from the balance of `from` for the benefit of every
+          * receiver listed in `delegations`, as if `delegatebw` was called once per entry without
+          * the transfer flag. Tokens are staked with a single transfer of the aggregate amount,
+          * and the voting power of `from` is updated only once.
+          *
+          * @param from - the account to delegate bandwidth from,
+          * @param delegations - receivers and the NET and CPU quantities staked to each of them.
+          *
+          * @post All producers `from` account has voted for will have their votes updated immediately.
+          */
+         [[eosio::action]]
+         void delegatemany( const name& from, const std::vector<bandwidth_delegation>& delegations );
+
+         /**
+          * Undelegate many action, unstakes tokens delegated by `from` to every receiver listed
+          * in `delegations`, as if `undelegatebw` was called once per entry. The aggregate amount
+          * is added to a single refund request, and the voting power of `from` is updated only once.
+          *
+          * @param from - the account to undelegate bandwidth from,
+          * @param delegations - receivers and the NET and CPU quantities unstaked from each of them.
+          *
+          * @post All producers `from` account has voted for will have their votes updated immediately.
+          */
+         [[eosio::action]]
+         void undelegmany( const name& from, const std::vector<bandwidth_delegation>& delegations );
+
+         /**
+          * Fill inbound action, adds the inbound delegation rows missing for the delegations of
+          * `delegators`, such as delegations made before inbound delegations were tracked and not
+          * changed since. Until every delegator has been filled in, the inbound delegations of an
+          * account may be incomplete. Storage of the added rows is billed to the system contract.
+          *
+          * @param delegators - the accounts whose delegations are mirrored into the inbound delegations.
+          */
+         [[eosio::action]]
+         void fillinbound( const std::vector<name>& delegators );
+
          /**
           * Buy ram action, increases receiver's ram quota based upon current price and quantity of
           * tokens provided. An inline transfer from receiver to system contract of
@@ -977,6 +1135,29 @@ namespace eosiosystem {
          [[eosio::action]]
          void refund( const name& owner );
 
+         /**
+          * Process refunds action, pays out up to `max` matured refund requests, oldest first.
+          * Anyone can run this action on behalf of the owners of the matured refunds.
+          * From revision 5 refunds are paid with `syspayout`, which does not notify the owners,
+          * so that an owner rejecting notifications can not block the refunds queued after its own.
+          *
+          * @param user - any account can execute this action,
+          * @param max - number of matured refund requests to be processed.
+          */
+         [[eosio::action]]
+         void procrefunds( const name& user, uint16_t max );
+
+         /**
+          * Queue refunds action, adds the pending refund requests of `owners` that are missing from
+          * the refund queue, such as the requests made before the queue was added, so that they are
+          * processed by `procrefunds`. Owners whose request is already queued are skipped.
+          * Storage of the added queue entries is billed to the system contract.
+          *
+          * @param owners - the owners of the pending refund requests to queue.
+          */
+         [[eosio::action]]
+         void queuerefunds( const std::vector<name>& owners );
+
          // functions defined in voting.cpp
 
          /**
@@ -1020,6 +1201,22 @@ namespace eosiosystem {
          [[eosio::action]]
          void unregprod( const name& producer );
 
+         /**
+          * Migrate votepay checkpoints action, moves the votepay checkpoints of up to `max` producers from the
+          * producers2 table into their rows of the producers table, so that votes for them no longer write
+          * producers2. Rows of the producers2 table are visited in order starting at `lower_bound`; those of
+          * unregistered producers are kept until the producers register again. The growth of the producers rows
+          * is billed to this contract. Any account can execute this action.
+          *
+          * @param user - any account can execute this action,
+          * @param lower_bound - producer to start visiting the producers2 table from,
+          * @param max - maximum number of producers2 rows to be visited.
+          *
+          * @pre Revision must be at least 4.
+          */
+         [[eosio::action]]
+         void migratevpay( const name& user, const name& lower_bound, uint16_t max );
+
          /**
           * Set ram action sets the ram supply.
           * @param max_ram_size - the amount of ram supply to set.
@@ -1089,11 +1286,34 @@ namespace eosiosystem {
 
          /**
           * Claim rewards action, claims block producing and vote rewards.
+          * Until revision 3 the inflation accrued since the last claim is issued by this action.
+          * From revision 3 inflation is accrued by `onblock` at most once per hour without being issued,
+          * and claims issue what has accrued so far in a single `issue` before paying the producer.
+          *
           * @param owner - producer account claiming per-block and per-vote rewards.
           */
          [[eosio::action]]
          void claimrewards( const name& owner );
 
+         /**
+          * Settle rewards action, pays the block producing and vote rewards of up to `max` active
+          * producers in one pass. Inflation is issued once for the whole batch; from revision 3 it is
+          * accrued by `onblock` and the batch issues what has accrued so far. Producers are visited
+          * from the highest total votes to the lowest and every visited producer counts toward `max`;
+          * only those with unpaid blocks that have not claimed rewards within the past day are paid.
+          * A batch resumes from `lower_bound`, the first producer the previous batch did not visit.
+          * From revision 5 the payouts do not notify the producers. Any account can execute this action.
+          *
+          * @param user - any account can execute this action,
+          * @param lower_bound - producer to start visiting from, or an empty name to start from the top,
+          * @param max - maximum number of producers to be visited.
+          *
+          * @pre The chain must be activated.
+          * @pre If set, `lower_bound` must be a registered producer.
+          */
+         [[eosio::action]]
+         void settlerewards( const name& user, const name& lower_bound, uint16_t max );
+
          /**
           * Set privilege status for an account. Allows to set privilege status for an account (turn it on/off).
           * @param account - the account to set the privileged status for.
@@ -1114,7 +1334,9 @@ namespace eosiosystem {
           * @param revision - it has to be incremented by 1 compared with current revision.
           *
           * @pre Current revision can not be higher than 254, and has to be smaller
-          * than or equal 1 (“set upper bound to greatest revision supported in the code”).
+          * than or equal 5 (“set upper bound to greatest revision supported in the code”),
+          * @pre Before moving to revision 5, the token contract has to be upgraded to a version that
+          * implements the `systransfer` and `syspayout` actions, which revision 5 uses for every payout.
           */
          [[eosio::action]]
          void updtrevision( uint8_t revision );
@@ -1140,6 +1362,8 @@ namespace eosiosystem {
 
          /**
           * Bid refund action, allows the account `bidder` to get back the amount it bid so far on a `newname` name.
+          * Only refunds recorded per name, before outbid amounts were accumulated in the bid refund ledger,
+          * can be claimed with this action.
           *
           * @param bidder - the account that gets refunded,
           * @param newname - the name for which the bid was placed and now it gets refunded for.
@@ -1147,6 +1371,40 @@ namespace eosiosystem {
          [[eosio::action]]
          void bidrefund( const name& bidder, const name& newname );
 
+         /**
+          * Claim bid refund action, transfers to `bidder` the whole amount accumulated in the bid
+          * refund ledger from all the name auctions it has been outbid on.
+          *
+          * @param bidder - the account that gets refunded.
+          */
+         [[eosio::action]]
+         void claimbidref( const name& bidder );
+
+         /**
+          * Flush bid refunds action, pays out up to `max` rows of the bid refund ledger
+          * to their bidders. Any account can execute this action. From revision 5 refunds are paid
+          * with `syspayout`, which does not notify the bidders, so that a bidder rejecting notifications
+          * can not block the refunds of the bidders after it.
+          *
+          * @param user - any account can execute this action,
+          * @param max - number of bid refund ledger rows to be paid out.
+          */
+         [[eosio::action]]
+         void flushbidrefs( const name& user, uint16_t max );
+
+         /**
+          * Close bids action, closes up to `max` name auctions whose highest bid is older than one day,
+          * from the highest bid to the lowest. Auctions with a bid in the past day are skipped, and at most
+          * `max_closebids_visits` auctions are visited, closed or skipped. Any account can execute this action.
+          *
+          * @param user - any account can execute this action,
+          * @param max - number of auctions to be closed.
+          *
+          * @pre At least 14 days must have passed since the chain was activated.
+          */
+         [[eosio::action]]
+         void closebids( const name& user, uint16_t max );
+
          /**
           * Change the annual inflation rate of the core token supply and specify how
           * the new issued tokens will be distributed based on the following structure.
@@ -1192,22 +1450,32 @@ namespace eosiosystem {
          using consolidate_action = eosio::action_wrapper<"consolidate"_n, &system_contract::consolidate>;
          using closerex_action = eosio::action_wrapper<"closerex"_n, &system_contract::closerex>;
          using undelegatebw_action = eosio::action_wrapper<"undelegatebw"_n, &system_contract::undelegatebw>;
+         using delegatemany_action = eosio::action_wrapper<"delegatemany"_n, &system_contract::delegatemany>;
+         using undelegmany_action = eosio::action_wrapper<"undelegmany"_n, &system_contract::undelegmany>;
+         using fillinbound_action = eosio::action_wrapper<"fillinbound"_n, &system_contract::fillinbound>;
          using buyram_action = eosio::action_wrapper<"buyram"_n, &system_contract::buyram>;
          using buyrambytes_action = eosio::action_wrapper<"buyrambytes"_n, &system_contract::buyrambytes>;
          using sellram_action = eosio::action_wrapper<"sellram"_n, &system_contract::sellram>;
          using refund_action = eosio::action_wrapper<"refund"_n, &system_contract::refund>;
+         using procrefunds_action = eosio::action_wrapper<"procrefunds"_n, &system_contract::procrefunds>;
+         using queuerefunds_action = eosio::action_wrapper<"queuerefunds"_n, &system_contract::queuerefunds>;
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &system_contract::regproducer>;
          using regproducer2_action = eosio::action_wrapper<"regproducer2"_n, &system_contract::regproducer2>;
          using unregprod_action = eosio::action_wrapper<"unregprod"_n, &system_contract::unregprod>;
+         using migratevpay_action = eosio::action_wrapper<"migratevpay"_n, &system_contract::migratevpay>;
          using setram_action = eosio::action_wrapper<"setram"_n, &system_contract::setram>;
          using setramrate_action = eosio::action_wrapper<"setramrate"_n, &system_contract::setramrate>;
          using voteproducer_action = eosio::action_wrapper<"voteproducer"_n, &system_contract::voteproducer>;
          using regproxy_action = eosio::action_wrapper<"regproxy"_n, &system_contract::regproxy>;
          using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
+         using settlerewards_action = eosio::action_wrapper<"settlerewards"_n, &system_contract::settlerewards>;
          using rmvproducer_action = eosio::action_wrapper<"rmvproducer"_n, &system_contract::rmvproducer>;
          using updtrevision_action = eosio::action_wrapper<"updtrevision"_n, &system_contract::updtrevision>;
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
          using bidrefund_action = eosio::action_wrapper<"bidrefund"_n, &system_contract::bidrefund>;
+         using claimbidref_action = eosio::action_wrapper<"claimbidref"_n, &system_contract::claimbidref>;
+         using flushbidrefs_action = eosio::action_wrapper<"flushbidrefs"_n, &system_contract::flushbidrefs>;
+         using closebids_action = eosio::action_wrapper<"closebids"_n, &system_contract::closebids>;
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
          using setalimits_action = eosio::action_wrapper<"setalimits"_n, &system_contract::setalimits>;
          using setparams_action = eosio::action_wrapper<"setparams"_n, &system_contract::setparams>;
@@ -1227,6 +1495,8 @@ namespace eosiosystem {
          static eosio_global_state4 get_default_inflation_parameters();
          symbol core_symbol()const;
          void update_ram_supply();
+         void system_transfer( const name& from, const name& to, const asset& quantity, const std::string& memo );
+         void system_payout( const name& from, const name& to, const asset& quantity, const std::string& memo );
 
          // defined in rex.cpp
          void runrex( uint16_t max );
@@ -1237,6 +1507,7 @@ namespace eosiosystem {
          rex_order_outcome fill_rex_order( const rex_balance_table::const_iterator& bitr, const asset& rex );
          asset update_rex_account( const name& owner, const asset& proceeds, const asset& unstake_quant, bool force_vote_update = false );
          void channel_to_rex( const name& from, const asset& amount );
+         void channel_ram_fee_to_rex( const name& payer, const asset& fee, const std::string& memo );
          void channel_namebid_to_rex( const int64_t highest_bid );
          template <typename T>
          int64_t rent_rex( T& table, const name& from, const name& receiver, const asset& loan_payment, const asset& loan_fund );
@@ -1268,13 +1539,34 @@ namespace eosiosystem {
          // defined in delegate_bandwidth.cpp
          void changebw( name from, const name& receiver,
                         const asset& stake_net_quantity, const asset& stake_cpu_quantity, bool transfer );
+         void update_delegated_bandwidth( const name& from, const name& receiver,
+                                          const asset& stake_net_delta, const asset& stake_cpu_delta );
+         asset update_refund( const name& owner, const asset& net_delta, const asset& cpu_delta );
+         void update_inbound_delegation( const name& from, const name& receiver,
+                                         const asset& net_weight, const asset& cpu_weight );
          void update_voting_power( const name& voter, const asset& total_update );
+         void enqueue_refund( const name& owner, const time_point_sec& request_time, const name& payer );
+         void dequeue_refund( const name& owner );
+
+         // defined in producer_pay.cpp
+         void count_unpaid_block( const name& producer );
+         void fold_unpaid_blocks();
+         void fill_reward_buckets( const time_point& ct );
+         void accrue_inflation( const time_point& ct );
+         void issue_accrued_inflation();
+         void issue_inflation( int64_t to_savings, int64_t to_per_block_pay, int64_t to_per_vote_pay );
+         void pay_producer( const producer_info& prod, const time_point& ct, bool claimed_by_owner );
 
          // defined in voting.cpp
          void register_producer( const name& producer, const eosio::block_signing_authority& producer_authority, const std::string& url, uint16_t location );
          void update_elected_producers( const block_timestamp& timestamp );
          void update_votes( const name& voter, const name& proxy, const std::vector<name>& producers, bool voting );
          void propagate_weight_change( const voter_info& voter );
+         std::optional<producer_votepay_checkpoint> get_votepay_checkpoint( const producer_info& prod );
+         void set_producer2_checkpoint( const name& owner, const producer_votepay_checkpoint& checkpoint, const name& payer );
+         void erase_producer2( const name& owner );
+         void update_producer_votes( const producer_info& prod, double delta, const time_point& ct,
+                                     double& delta_change_rate, double& total_inactive_vpay_share );
          double update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
                                                const time_point& ct,
                                                double shares_rate, bool reset_to_zero = false );
@@ -3,14 +3,10 @@
 #include <eosio/multi_index.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/serialize.hpp>
-#include <eosio/transaction.hpp>
 
 #include <eosio.system/eosio.system.hpp>
 #include <eosio.token/eosio.token.hpp>
 
-#include "name_bidding.cpp"
-// Unfortunately, this is needed until CDT fixes the duplicate symbol error with eosio::send_deferred
-
 namespace eosiosystem {
 
    using eosio::asset;
@@ -65,9 +61,7 @@ namespace eosiosystem {
          transfer_act.send( payer, ram_account, quant_after_fee, "buy ram" );
       }
       if ( fee.amount > 0 ) {
-         token::transfer_action transfer_act{ token_account, { {payer, active_permission} } };
-         transfer_act.send( payer, ramfee_account, fee, "ram fee" );
-         channel_to_rex( ramfee_account, fee );
+         channel_ram_fee_to_rex( payer, fee, "ram fee" );
       }
 
       int64_t bytes_out;
@@ -155,9 +149,7 @@ namespace eosiosystem {
       auto fee = ( tokens_out.amount + 199 ) / 200; /// .5% fee (round up)
       // since tokens_out.amount was asserted to be at least 2 earlier, fee.amount < tokens_out.amount
       if ( fee > 0 ) {
-         token::transfer_action transfer_act{ token_account, { {account, active_permission} } };
-         transfer_act.send( account, ramfee_account, asset(fee, core_symbol()), "sell ram fee" );
-         channel_to_rex( ramfee_account, asset(fee, core_symbol() ));
+         channel_ram_fee_to_rex( account, asset(fee, core_symbol()), "sell ram fee" );
       }
    }
 
@@ -183,6 +175,33 @@ namespace eosiosystem {
          from = receiver;
       }
 
+      update_delegated_bandwidth( from, receiver, stake_net_delta, stake_cpu_delta );
+
+      // create refund or update from existing refund
+      if ( stake_account != source_stake_from ) { //for eosio both transfer and refund make no sense
+         // net and cpu are same sign by assertions in delegatebw and undelegatebw
+         // redundant assertion also at start of changebw to protect against misuse of changebw
+         bool is_undelegating = (stake_net_delta.amount + stake_cpu_delta.amount ) < 0;
+         bool is_delegating_to_self = (!transfer && from == receiver);
+
+         auto transfer_amount = stake_net_delta + stake_cpu_delta;
+         if( is_delegating_to_self || is_undelegating ) {
+            transfer_amount = update_refund( from, stake_net_delta, stake_cpu_delta );
+         }
+
+         if ( 0 < transfer_amount.amount ) {
+            token::transfer_action transfer_act{ token_account, { {source_stake_from, active_permission} } };
+            transfer_act.send( source_stake_from, stake_account, asset(transfer_amount), "stake bandwidth" );
+         }
+      }
+
+      vote_stake_updater( from );
+      update_voting_power( from, stake_net_delta + stake_cpu_delta );
+   }
+
+   void system_contract::update_delegated_bandwidth( const name& from, const name& receiver,
+                                                     const asset& stake_net_delta, const asset& stake_cpu_delta )
+   {
       // update stake delegated from "from" to "receiver"
       {
          del_bandwidth_table     del_tbl( get_self(), from.value );
@@ -203,6 +222,7 @@ namespace eosiosystem {
          }
          check( 0 <= itr->net_weight.amount, "insufficient staked net bandwidth" );
          check( 0 <= itr->cpu_weight.amount, "insufficient staked cpu bandwidth" );
+         update_inbound_delegation( from, receiver, itr->net_weight, itr->cpu_weight );
          if ( itr->is_empty() ) {
             del_tbl.erase( itr );
          }
@@ -254,97 +274,99 @@ namespace eosiosystem {
             totals_tbl.erase( tot_itr );
          }
       } // tot_itr can be invalid, should go out of scope
+   }
 
-      // create refund or update from existing refund
-      if ( stake_account != source_stake_from ) { //for eosio both transfer and refund make no sense
-         refunds_table refunds_tbl( get_self(), from.value );
-         auto req = refunds_tbl.find( from.value );
+   void system_contract::update_inbound_delegation( const name& from, const name& receiver,
+                                                    const asset& net_weight, const asset& cpu_weight )
+   {
+      inbound_delegation_table inbound_tbl( get_self(), receiver.value );
+      auto itr = inbound_tbl.find( from.value );
+      if ( net_weight.amount == 0 && cpu_weight.amount == 0 ) {
+         if ( itr != inbound_tbl.end() ) {
+            inbound_tbl.erase( itr );
+         }
+      } else if ( itr == inbound_tbl.end() ) {
+         // also covers delegations made before inbound delegations were tracked
+         inbound_tbl.emplace( from, [&]( auto& dbi ) {
+            dbi.from       = from;
+            dbi.to         = receiver;
+            dbi.net_weight = net_weight;
+            dbi.cpu_weight = cpu_weight;
+         });
+      } else {
+         inbound_tbl.modify( itr, same_payer, [&]( auto& dbi ) {
+            dbi.net_weight = net_weight;
+            dbi.cpu_weight = cpu_weight;
+         });
+      }
+   }
 
-         //create/update/delete refund
-         auto net_balance = stake_net_delta;
-         auto cpu_balance = stake_cpu_delta;
-         bool need_deferred_trx = false;
+   asset system_contract::update_refund( const name& owner, const asset& net_delta, const asset& cpu_delta )
+   {
+      refunds_table refunds_tbl( get_self(), owner.value );
+      auto req = refunds_tbl.find( owner.value );
 
+      //create/update/delete refund
+      auto net_balance = net_delta;
+      auto cpu_balance = cpu_delta;
+      bool need_refund_queue_entry = false;
 
-         // net and cpu are same sign by assertions in delegatebw and undelegatebw
-         // redundant assertion also at start of changebw to protect against misuse of changebw
-         bool is_undelegating = (net_balance.amount + cpu_balance.amount ) < 0;
-         bool is_delegating_to_self = (!transfer && from == receiver);
+      if ( req != refunds_tbl.end() ) { //need to update refund
+         refunds_tbl.modify( req, same_payer, [&]( refund_request& r ) {
+            if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) {
+               r.request_time = current_time_point();
+            }
+            r.net_amount -= net_balance;
+            if ( r.net_amount.amount < 0 ) {
+               net_balance = -r.net_amount;
+               r.net_amount.amount = 0;
+            } else {
+               net_balance.amount = 0;
+            }
+            r.cpu_amount -= cpu_balance;
+            if ( r.cpu_amount.amount < 0 ){
+               cpu_balance = -r.cpu_amount;
+               r.cpu_amount.amount = 0;
+            } else {
+               cpu_balance.amount = 0;
+            }
+         });
 
-         if( is_delegating_to_self || is_undelegating ) {
-            if ( req != refunds_tbl.end() ) { //need to update refund
-               refunds_tbl.modify( req, same_payer, [&]( refund_request& r ) {
-                  if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) {
-                     r.request_time = current_time_point();
-                  }
-                  r.net_amount -= net_balance;
-                  if ( r.net_amount.amount < 0 ) {
-                     net_balance = -r.net_amount;
-                     r.net_amount.amount = 0;
-                  } else {
-                     net_balance.amount = 0;
-                  }
-                  r.cpu_amount -= cpu_balance;
-                  if ( r.cpu_amount.amount < 0 ){
-                     cpu_balance = -r.cpu_amount;
-                     r.cpu_amount.amount = 0;
-                  } else {
-                     cpu_balance.amount = 0;
-                  }
-               });
+         check( 0 <= req->net_amount.amount, "negative net refund amount" ); //should never happen
+         check( 0 <= req->cpu_amount.amount, "negative cpu refund amount" ); //should never happen
 
-               check( 0 <= req->net_amount.amount, "negative net refund amount" ); //should never happen
-               check( 0 <= req->cpu_amount.amount, "negative cpu refund amount" ); //should never happen
-
-               if ( req->is_empty() ) {
-                  refunds_tbl.erase( req );
-                  need_deferred_trx = false;
-               } else {
-                  need_deferred_trx = true;
-               }
-            } else if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) { //need to create refund
-               refunds_tbl.emplace( from, [&]( refund_request& r ) {
-                  r.owner = from;
-                  if ( net_balance.amount < 0 ) {
-                     r.net_amount = -net_balance;
-                     net_balance.amount = 0;
-                  } else {
-                     r.net_amount = asset( 0, core_symbol() );
-                  }
-                  if ( cpu_balance.amount < 0 ) {
-                     r.cpu_amount = -cpu_balance;
-                     cpu_balance.amount = 0;
-                  } else {
-                     r.cpu_amount = asset( 0, core_symbol() );
-                  }
-                  r.request_time = current_time_point();
-               });
-               need_deferred_trx = true;
-            } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
-         } /// end if is_delegating_to_self || is_undelegating
-
-         if ( need_deferred_trx ) {
-            eosio::transaction out;
-            out.actions.emplace_back( permission_level{from, active_permission},
-                                      get_self(), "refund"_n,
-                                      from
-            );
-            out.delay_sec = refund_delay_sec;
-            eosio::cancel_deferred( from.value ); // TODO: Remove this line when replacing deferred trxs is fixed
-            out.send( from.value, from, true );
+         if ( req->is_empty() ) {
+            refunds_tbl.erase( req );
+            dequeue_refund( owner );
+            need_refund_queue_entry = false;
          } else {
-            eosio::cancel_deferred( from.value );
+            need_refund_queue_entry = true;
          }
+      } else if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) { //need to create refund
+         refunds_tbl.emplace( owner, [&]( refund_request& r ) {
+            r.owner = owner;
+            if ( net_balance.amount < 0 ) {
+               r.net_amount = -net_balance;
+               net_balance.amount = 0;
+            } else {
+               r.net_amount = asset( 0, core_symbol() );
+            }
+            if ( cpu_balance.amount < 0 ) {
+               r.cpu_amount = -cpu_balance;
+               cpu_balance.amount = 0;
+            } else {
+               r.cpu_amount = asset( 0, core_symbol() );
+            }
+            r.request_time = current_time_point();
+         });
+         need_refund_queue_entry = true;
+      } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
 
-         auto transfer_amount = net_balance + cpu_balance;
-         if ( 0 < transfer_amount.amount ) {
-            token::transfer_action transfer_act{ token_account, { {source_stake_from, active_permission} } };
-            transfer_act.send( source_stake_from, stake_account, asset(transfer_amount), "stake bandwidth" );
-         }
+      if ( need_refund_queue_entry ) {
+         enqueue_refund( owner, refunds_tbl.get( owner.value ).request_time, owner );
       }
 
-      vote_stake_updater( from );
-      update_voting_power( from, stake_net_delta + stake_cpu_delta );
+      return net_balance + cpu_balance;
    }
 
    void system_contract::update_voting_power( const name& voter, const asset& total_update )
@@ -368,7 +390,12 @@ namespace eosiosystem {
       }
 
       if( voter_itr->producers.size() || voter_itr->proxy ) {
-         update_votes( voter, voter_itr->proxy, voter_itr->producers, false );
+         if( _gstate.thresh_activated_stake_time != time_point() && voter_itr->last_vote_weight > 0 ) {
+            // producers or proxy are unchanged, only the difference in vote weight needs to be applied
+            propagate_weight_change( *voter_itr );
+         } else {
+            update_votes( voter, voter_itr->proxy, voter_itr->producers, false );
+         }
       }
    }
 
@@ -398,6 +425,95 @@ namespace eosiosystem {
       changebw( from, receiver, -unstake_net_quantity, -unstake_cpu_quantity, false);
    } // undelegatebw
 
+   void system_contract::delegatemany( const name& from, const std::vector<bandwidth_delegation>& delegations )
+   {
+      require_auth( from );
+      check( !delegations.empty(), "no delegations specified" );
+
+      asset zero_asset( 0, core_symbol() );
+      asset self_net_delta = zero_asset;
+      asset self_cpu_delta = zero_asset;
+      asset delegated_to_others = zero_asset;
+      for ( const auto& d : delegations ) {
+         check( d.cpu_quantity >= zero_asset, "must stake a positive amount" );
+         check( d.net_quantity >= zero_asset, "must stake a positive amount" );
+         check( d.net_quantity.amount + d.cpu_quantity.amount > 0, "must stake a positive amount" );
+
+         update_delegated_bandwidth( from, d.receiver, d.net_quantity, d.cpu_quantity );
+         if ( d.receiver == from ) {
+            self_net_delta += d.net_quantity;
+            self_cpu_delta += d.cpu_quantity;
+         } else {
+            delegated_to_others += d.net_quantity + d.cpu_quantity;
+         }
+      }
+
+      if ( stake_account != from ) {
+         // only stake delegated to self can be taken from a pending refund, same as delegatebw
+         auto transfer_amount = delegated_to_others;
+         if ( 0 < self_net_delta.amount + self_cpu_delta.amount ) {
+            transfer_amount += update_refund( from, self_net_delta, self_cpu_delta );
+         }
+         if ( 0 < transfer_amount.amount ) {
+            token::transfer_action transfer_act{ token_account, { {from, active_permission} } };
+            transfer_act.send( from, stake_account, transfer_amount, "stake bandwidth" );
+         }
+      }
+
+      vote_stake_updater( from );
+      update_voting_power( from, self_net_delta + self_cpu_delta + delegated_to_others );
+   } // delegatemany
+
+   void system_contract::undelegmany( const name& from, const std::vector<bandwidth_delegation>& delegations )
+   {
+      require_auth( from );
+      check( !delegations.empty(), "no delegations specified" );
+      check( _gstate.thresh_activated_stake_time != time_point(),
+             "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
+
+      asset zero_asset( 0, core_symbol() );
+      asset unstake_net_total = zero_asset;
+      asset unstake_cpu_total = zero_asset;
+      for ( const auto& d : delegations ) {
+         check( d.cpu_quantity >= zero_asset, "must unstake a positive amount" );
+         check( d.net_quantity >= zero_asset, "must unstake a positive amount" );
+         check( d.net_quantity.amount + d.cpu_quantity.amount > 0, "must unstake a positive amount" );
+
+         update_delegated_bandwidth( from, d.receiver, -d.net_quantity, -d.cpu_quantity );
+         unstake_net_total += d.net_quantity;
+         unstake_cpu_total += d.cpu_quantity;
+      }
+
+      if ( stake_account != from ) {
+         update_refund( from, -unstake_net_total, -unstake_cpu_total );
+      }
+
+      vote_stake_updater( from );
+      update_voting_power( from, -(unstake_net_total + unstake_cpu_total) );
+   } // undelegmany
+
+   void system_contract::fillinbound( const std::vector<name>& delegators )
+   {
+      require_auth( get_self() );
+      check( !delegators.empty(), "no delegators specified" );
+
+      for ( const auto& from : delegators ) {
+         del_bandwidth_table del_tbl( get_self(), from.value );
+         for ( const auto& dbo : del_tbl ) {
+            inbound_delegation_table inbound_tbl( get_self(), dbo.to.value );
+            // rows already there are kept up to date by changebw
+            if ( inbound_tbl.find( from.value ) == inbound_tbl.end() ) {
+               inbound_tbl.emplace( get_self(), [&]( auto& dbi ) {
+                  dbi.from       = from;
+                  dbi.to         = dbo.to;
+                  dbi.net_weight = dbo.net_weight;
+                  dbi.cpu_weight = dbo.cpu_weight;
+               });
+            }
+         }
+      }
+   }
+
 
    void system_contract::refund( const name& owner ) {
       require_auth( owner );
@@ -410,6 +526,66 @@ namespace eosiosystem {
       token::transfer_action transfer_act{ token_account, { {stake_account, active_permission}, {req->owner, active_permission} } };
       transfer_act.send( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
       refunds_tbl.erase( req );
+      dequeue_refund( owner );
+   }
+
+   void system_contract::procrefunds( const name& user, uint16_t max ) {
+      require_auth( user );
+
+      refund_queue_table refund_queue( get_self(), get_self().value );
+      auto idx = refund_queue.get_index<"bytime"_n>();
+      const time_point ct = current_time_point();
+      uint16_t processed = 0;
+      for ( auto itr = idx.begin(); processed < max && itr != idx.end(); ++processed ) {
+         if ( ct < itr->request_time + seconds(refund_delay_sec) ) {
+            break;
+         }
+         refunds_table refunds_tbl( get_self(), itr->owner.value );
+         auto req = refunds_tbl.find( itr->owner.value );
+         if ( req != refunds_tbl.end() ) {
+            system_payout( stake_account, req->owner, req->net_amount + req->cpu_amount, "unstake" );
+            refunds_tbl.erase( req );
+         }
+         itr = idx.erase( itr );
+      }
+   }
+
+   void system_contract::queuerefunds( const std::vector<name>& owners ) {
+      require_auth( get_self() );
+      check( !owners.empty(), "no owners specified" );
+
+      refund_queue_table refund_queue( get_self(), get_self().value );
+      for ( const auto& owner : owners ) {
+         if ( refund_queue.find( owner.value ) != refund_queue.end() ) {
+            continue;
+         }
+         refunds_table refunds_tbl( get_self(), owner.value );
+         const auto& req = refunds_tbl.get( owner.value, "refund request not found" );
+         enqueue_refund( owner, req.request_time, get_self() );
+      }
+   }
+
+   void system_contract::enqueue_refund( const name& owner, const time_point_sec& request_time, const name& payer ) {
+      refund_queue_table refund_queue( get_self(), get_self().value );
+      auto itr = refund_queue.find( owner.value );
+      if ( itr == refund_queue.end() ) {
+         refund_queue.emplace( payer, [&]( auto& q ) {
+            q.owner        = owner;
+            q.request_time = request_time;
+         });
+      } else if ( itr->request_time != request_time ) {
+         refund_queue.modify( itr, same_payer, [&]( auto& q ) {
+            q.request_time = request_time;
+         });
+      }
+   }
+
+   void system_contract::dequeue_refund( const name& owner ) {
+      refund_queue_table refund_queue( get_self(), get_self().value );
+      auto itr = refund_queue.find( owner.value );
+      if ( itr != refund_queue.end() ) {
+         refund_queue.erase( itr );
+      }
    }
 
 
@@ -15,6 +15,15 @@ namespace eosiosystem {
       return std::log1p(double(annual_rate)/double(100*inflation_precision));
    }
 
+   // Rewrites a global state singleton only if its contents changed, e.g. votes that do not change
+   // the votepay share rate leave global2 and global3 untouched.
+   template<typename Singleton, typename State>
+   void store_global_state( Singleton& singleton, const State& state, name payer ) {
+      if( singleton.exists() && eosio::pack( singleton.get() ) == eosio::pack( state ) )
+         return;
+      singleton.set( state, payer );
+   }
+
    system_contract::system_contract( name s, name code, datastream<const char*> ds )
    :native(s,code,ds),
     _voters(get_self(), get_self().value),
@@ -58,10 +67,12 @@ namespace eosiosystem {
    }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, get_self() );
-      _global2.set( _gstate2, get_self() );
-      _global3.set( _gstate3, get_self() );
-      _global4.set( _gstate4, get_self() );
+      if( !_globals_modified )
+         return;
+      store_global_state( _global,  _gstate,  get_self() );
+      store_global_state( _global2, _gstate2, get_self() );
+      store_global_state( _global3, _gstate3, get_self() );
+      store_global_state( _global4, _gstate4, get_self() );
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
@@ -102,6 +113,38 @@ namespace eosiosystem {
       _gstate2.last_ram_increase = cbt;
    }
 
+   /**
+    * Transfers tokens between two system accounts. From revision 5 the transfer is made with
+    * `systransfer`, which does not notify the system accounts, saving one action per party.
+    */
+   void system_contract::system_transfer( const name& from, const name& to, const asset& quantity, const std::string& memo ) {
+      if( _gstate2.revision >= 5 ) {
+         std::vector<permission_level> auth{ {get_self(), active_permission} };
+         if( from != get_self() ) {
+            auth.push_back( {from, active_permission} );
+         }
+         token::systransfer_action systransfer_act{ token_account, auth };
+         systransfer_act.send( from, to, quantity, memo );
+      } else {
+         token::transfer_action transfer_act{ token_account, { {from, active_permission} } };
+         transfer_act.send( from, to, quantity, memo );
+      }
+   }
+
+   /**
+    * Pays tokens out of a system account, as part of a batch of payouts. From revision 5 the payout is
+    * made with `syspayout`, which notifies nobody, so that a recipient can not abort the whole batch.
+    */
+   void system_contract::system_payout( const name& from, const name& to, const asset& quantity, const std::string& memo ) {
+      if( _gstate2.revision >= 5 ) {
+         token::syspayout_action syspayout_act{ token_account, { {get_self(), active_permission}, {from, active_permission} } };
+         syspayout_act.send( from, to, quantity, memo );
+      } else {
+         token::transfer_action transfer_act{ token_account, { {from, active_permission} } };
+         transfer_act.send( from, to, quantity, memo );
+      }
+   }
+
    void system_contract::setramrate( uint16_t bytes_per_block ) {
       require_auth( get_self() );
 
@@ -281,6 +324,9 @@ namespace eosiosystem {
       require_auth( get_self() );
       auto prod = _producers.find( producer.value );
       check( prod != _producers.end(), "producer not found" );
+      if( prod->votepay_checkpoint.has_value() ) {
+         set_producer2_checkpoint( producer, *prod->votepay_checkpoint, get_self() );
+      }
       _producers.modify( prod, same_payer, [&](auto& p) {
             p.deactivate();
          });
@@ -290,8 +336,11 @@ namespace eosiosystem {
       require_auth( get_self() );
       check( _gstate2.revision < 255, "can not increment revision" ); // prevent wrap around
       check( revision == _gstate2.revision + 1, "can only increment revision by one" );
-      check( revision <= 1, // set upper bound to greatest revision supported in the code
+      check( revision <= 5, // set upper bound to greatest revision supported in the code
              "specified revision is not yet supported by the code" );
+      // revision 5 pays out with the `systransfer` and `syspayout` actions of the token contract, which can not
+      // be checked from here: the token contract has to be upgraded before moving to revision 5, otherwise every
+      // payout (refunds, rewards, name bid refunds) fails
       _gstate2.revision = revision;
    }
 
@@ -304,6 +353,10 @@ namespace eosiosystem {
       if ( votepay_factor < pay_factor_precision ) {
          check( false, "votepay_factor must not be less than " + std::to_string(pay_factor_precision) );
       }
+      // from revision 3, inflation is accrued at the previous rate up to now before it changes
+      if( _gstate2.revision >= 3 ) {
+         accrue_inflation( current_time_point() );
+      }
       _gstate4.continuous_rate      = get_continuous_rate(annual_rate);
       _gstate4.inflation_pay_factor = inflation_pay_factor;
       _gstate4.votepay_factor       = votepay_factor;
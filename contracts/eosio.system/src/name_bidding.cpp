@@ -1,11 +1,14 @@
+#include <eosio/eosio.hpp>
+
 #include <eosio.system/eosio.system.hpp>
 #include <eosio.token/eosio.token.hpp>
 
-#include <eosio/transaction.hpp>
+#include <limits>
 
 namespace eosiosystem {
 
    using eosio::current_time_point;
+   using eosio::microseconds;
    using eosio::token;
 
    void system_contract::bidname( const name& bidder, const name& newname, const asset& bid ) {
@@ -35,30 +38,19 @@ namespace eosiosystem {
          check( bid.amount - current->high_bid > (current->high_bid / 10), "must increase bid by 10%" );
          check( current->high_bidder != bidder, "account is already highest bidder" );
 
-         bid_refund_table refunds_table(get_self(), newname.value);
-
-         auto it = refunds_table.find( current->high_bidder.value );
-         if ( it != refunds_table.end() ) {
-            refunds_table.modify( it, same_payer, [&](auto& r) {
+         bid_refund_ledger_table ledger(get_self(), get_self().value);
+         auto it = ledger.find( current->high_bidder.value );
+         if ( it != ledger.end() ) {
+            ledger.modify( it, same_payer, [&](auto& r) {
                   r.amount += asset( current->high_bid, core_symbol() );
                });
          } else {
-            refunds_table.emplace( bidder, [&](auto& r) {
+            ledger.emplace( bidder, [&](auto& r) {
                   r.bidder = current->high_bidder;
                   r.amount = asset( current->high_bid, core_symbol() );
                });
          }
 
-         eosio::transaction t;
-         t.actions.emplace_back( permission_level{current->high_bidder, active_permission},
-                                 get_self(), "bidrefund"_n,
-                                 std::make_tuple( current->high_bidder, newname )
-         );
-         t.delay_sec = 0;
-         uint128_t deferred_id = (uint128_t(newname.value) << 64) | current->high_bidder.value;
-         eosio::cancel_deferred( deferred_id );
-         t.send( deferred_id, bidder );
-
          bids.modify( current, bidder, [&]( auto& b ) {
             b.high_bidder = bidder;
             b.high_bid = bid.amount;
@@ -77,4 +69,58 @@ namespace eosiosystem {
       refunds_table.erase( it );
    }
 
+   void system_contract::claimbidref( const name& bidder ) {
+      bid_refund_ledger_table ledger(get_self(), get_self().value);
+      auto it = ledger.find( bidder.value );
+      check( it != ledger.end(), "refund not found" );
+
+      token::transfer_action transfer_act{ token_account, { {names_account, active_permission} } };
+      transfer_act.send( names_account, bidder, it->amount, std::string("refund bids on names") );
+      ledger.erase( it );
+   }
+
+   void system_contract::flushbidrefs( const name& user, uint16_t max ) {
+      require_auth( user );
+
+      bid_refund_ledger_table ledger(get_self(), get_self().value);
+      auto it = ledger.begin();
+      for ( uint16_t i = 0; i < max && it != ledger.end(); ++i ) {
+         system_payout( names_account, it->bidder, it->amount, std::string("refund bids on names") );
+         it = ledger.erase( it );
+      }
+   }
+
+   void system_contract::closebids( const name& user, uint16_t max ) {
+      require_auth( user );
+
+      const auto ct = current_time_point();
+      check( _gstate.thresh_activated_stake_time > time_point() &&
+             (ct - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day),
+             "name auctions cannot be closed until 14 days after the chain is activated" );
+
+      name_bid_table bids(get_self(), get_self().value);
+      auto idx = bids.get_index<"highbid"_n>();
+      auto itr = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
+      // auctions with a bid in the past day are skipped without counting toward max, so that they can not
+      // hold back the eligible auctions with lower bids, but the visited auctions are bounded on their own
+      uint16_t closed = 0;
+      for ( uint16_t visited = 0; closed < max && visited < max_closebids_visits && itr != idx.end() && itr->high_bid > 0; ++visited ) {
+         auto next = itr;
+         ++next;
+         // closing an auction moves its entry out of the range of open auctions
+         if ( (ct - itr->last_bid_time) > microseconds(useconds_per_day) ) {
+            channel_namebid_to_rex( itr->high_bid );
+            idx.modify( itr, same_payer, [&]( auto& b ){
+               b.high_bid = -b.high_bid;
+            });
+            ++closed;
+         }
+         itr = next;
+      }
+
+      if ( closed > 0 ) {
+         _gstate.last_name_close = block_timestamp( ct );
+      }
+   }
+
 }
@@ -16,6 +16,20 @@ namespace eosiosystem {
       name producer;
       _ds >> timestamp >> producer;
 
+      /**
+       * From revision 2, blocks produced between producer schedule updates only bump the producer's
+       * entry in the block counter table; neither the producers table nor the global state is written.
+       * The deprecated `last_block_num` is left untouched on this path.
+       */
+      if( _gstate2.revision >= 2 &&
+          _gstate.thresh_activated_stake_time != time_point() &&
+          _gstate.last_pervote_bucket_fill != time_point() &&
+          timestamp.slot - _gstate.last_producer_schedule_update.slot <= 120 ) {
+         count_unpaid_block( producer );
+         _globals_modified = false;
+         return;
+      }
+
       // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
       // Although this field is deprecated, we will continue updating it for now until the last_block_num field
       // is eventually completely removed, at which point this line can be removed.
@@ -33,16 +47,27 @@ namespace eosiosystem {
        * At startup the initial producer may not be one that is registered / elected
        * and therefore there may be no producer object for them.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() ) {
-         _gstate.total_unpaid_blocks++;
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-               p.unpaid_blocks++;
-         });
+      if( _gstate2.revision >= 2 ) {
+         count_unpaid_block( producer );
+      } else {
+         auto prod = _producers.find( producer.value );
+         if ( prod != _producers.end() ) {
+            _gstate.total_unpaid_blocks++;
+            _producers.modify( prod, same_payer, [&](auto& p ) {
+                  p.unpaid_blocks++;
+            });
+         }
       }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
       if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
+         if( _gstate2.revision >= 2 ) {
+            fold_unpaid_blocks();
+         }
+         if( _gstate2.revision >= 3 &&
+             current_time_point() - _gstate.last_pervote_bucket_fill >= microseconds(inflation_accrual_interval) ) {
+            accrue_inflation( current_time_point() );
+         }
          update_elected_producers( timestamp );
 
          if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
@@ -65,19 +90,39 @@ namespace eosiosystem {
       }
    }
 
-   void system_contract::claimrewards( const name& owner ) {
-      require_auth( owner );
-
-      const auto& prod = _producers.get( owner.value );
-      check( prod.active(), "producer does not have an active key" );
-
-      check( _gstate.thresh_activated_stake_time != time_point(),
-                    "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
-
-      const auto ct = current_time_point();
+   void system_contract::count_unpaid_block( const name& producer ) {
+      producer_block_count_table counts( get_self(), get_self().value );
+      auto itr = counts.find( producer.value );
+      if( itr == counts.end() ) {
+         counts.emplace( get_self(), [&]( auto& c ) {
+            c.producer      = producer;
+            c.unpaid_blocks = 1;
+         });
+      } else {
+         counts.modify( itr, same_payer, [&]( auto& c ) {
+            c.unpaid_blocks++;
+         });
+      }
+   }
 
-      check( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
+   void system_contract::fold_unpaid_blocks() {
+      producer_block_count_table counts( get_self(), get_self().value );
+      for( auto itr = counts.begin(); itr != counts.end(); itr = counts.erase( itr ) ) {
+         /**
+          * At startup the initial producer may not be one that is registered / elected
+          * and therefore there may be no producer object for them.
+          */
+         auto prod = _producers.find( itr->producer.value );
+         if( prod != _producers.end() ) {
+            _gstate.total_unpaid_blocks += itr->unpaid_blocks;
+            _producers.modify( prod, same_payer, [&]( auto& p ) {
+               p.unpaid_blocks += itr->unpaid_blocks;
+            });
+         }
+      }
+   }
 
+   void system_contract::fill_reward_buckets( const time_point& ct ) {
       const asset token_supply   = token::get_supply(token_account, core_symbol().code() );
       const auto usecs_since_last_fill = (ct - _gstate.last_pervote_bucket_fill).count();
 
@@ -92,31 +137,83 @@ namespace eosiosystem {
          int64_t to_per_block_pay = (to_producers * uint128_t(pay_factor_precision)) / _gstate4.votepay_factor;
          int64_t to_per_vote_pay  = to_producers - to_per_block_pay;
 
-         if( new_tokens > 0 ) {
-            {
-               token::issue_action issue_act{ token_account, { {get_self(), active_permission} } };
-               issue_act.send( get_self(), asset(new_tokens, core_symbol()), "issue tokens for producer pay and savings" );
-            }
-            {
-               token::transfer_action transfer_act{ token_account, { {get_self(), active_permission} } };
-               if( to_savings > 0 ) {
-                  transfer_act.send( get_self(), saving_account, asset(to_savings, core_symbol()), "unallocated inflation" );
-               }
-               if( to_per_block_pay > 0 ) {
-                  transfer_act.send( get_self(), bpay_account, asset(to_per_block_pay, core_symbol()), "fund per-block bucket" );
-               }
-               if( to_per_vote_pay > 0 ) {
-                  transfer_act.send( get_self(), vpay_account, asset(to_per_vote_pay, core_symbol()), "fund per-vote bucket" );
-               }
-            }
-         }
+         issue_inflation( to_savings, to_per_block_pay, to_per_vote_pay );
 
          _gstate.pervote_bucket          += to_per_vote_pay;
          _gstate.perblock_bucket         += to_per_block_pay;
          _gstate.last_pervote_bucket_fill = ct;
       }
+   }
+
+   void system_contract::accrue_inflation( const time_point& ct ) {
+      /**
+       * From revision 3 inflation is only counted here, in integers, and issued by `issue_accrued_inflation`
+       * when rewards are claimed or settled. This is called by onblock, so it sends no inline action and
+       * never aborts: an accrual that would overflow is left for the next one.
+       */
+      const auto usecs_since_last_fill = (ct - _gstate.last_pervote_bucket_fill).count();
+      if( usecs_since_last_fill <= 0 || _gstate.last_pervote_bucket_fill == time_point() )
+         return;
+
+      const int64_t max_amount = std::numeric_limits<int64_t>::max();
+      const asset   token_supply = token::get_supply(token_account, core_symbol().code() );
+      auto unissued = _gstate4.unissued.has_value() ? *_gstate4.unissued : unissued_inflation{};
+
+      // fixed-point: continuous_rate is scaled by continuous_rate_precision, then all math is done on integers
+      const double scaled_rate = _gstate4.continuous_rate * double(continuous_rate_precision);
+      if( scaled_rate < 0.0 || scaled_rate > double(max_amount - ((1ll << 10) - 1)) )
+         return;
+      const uint128_t tokens_per_year = (uint128_t(token_supply.amount) * uint64_t(scaled_rate)) / continuous_rate_precision;
+      if( tokens_per_year > uint128_t(max_amount) )
+         return;
+      const uint128_t additional_inflation = (tokens_per_year * uint64_t(usecs_since_last_fill)) / useconds_per_year;
+      if( additional_inflation > uint128_t(max_amount - token_supply.amount - unissued.total()) )
+         return;
+      const int64_t new_tokens = int64_t(additional_inflation);
+
+      const int64_t to_producers     = (new_tokens * uint128_t(pay_factor_precision)) / _gstate4.inflation_pay_factor;
+      const int64_t to_per_block_pay = (to_producers * uint128_t(pay_factor_precision)) / _gstate4.votepay_factor;
+      unissued.to_savings       += new_tokens - to_producers;
+      unissued.to_per_block_pay += to_per_block_pay;
+      unissued.to_per_vote_pay  += to_producers - to_per_block_pay;
+      _gstate4.unissued.emplace( unissued );
+
+      _gstate.pervote_bucket          += to_producers - to_per_block_pay;
+      _gstate.perblock_bucket         += to_per_block_pay;
+      _gstate.last_pervote_bucket_fill = ct;
+   }
 
-      auto prod2 = _producers2.find( owner.value );
+   void system_contract::issue_accrued_inflation() {
+      if( !_gstate4.unissued.has_value() || _gstate4.unissued->total() == 0 )
+         return;
+
+      const auto unissued = *_gstate4.unissued;
+      issue_inflation( unissued.to_savings, unissued.to_per_block_pay, unissued.to_per_vote_pay );
+      _gstate4.unissued.emplace( unissued_inflation{} );
+   }
+
+   void system_contract::issue_inflation( int64_t to_savings, int64_t to_per_block_pay, int64_t to_per_vote_pay ) {
+      const int64_t new_tokens = to_savings + to_per_block_pay + to_per_vote_pay;
+      if( new_tokens <= 0 )
+         return;
+
+      {
+         token::issue_action issue_act{ token_account, { {get_self(), active_permission} } };
+         issue_act.send( get_self(), asset(new_tokens, core_symbol()), "issue tokens for producer pay and savings" );
+      }
+      if( to_savings > 0 ) {
+         system_transfer( get_self(), saving_account, asset(to_savings, core_symbol()), "unallocated inflation" );
+      }
+      if( to_per_block_pay > 0 ) {
+         system_transfer( get_self(), bpay_account, asset(to_per_block_pay, core_symbol()), "fund per-block bucket" );
+      }
+      if( to_per_vote_pay > 0 ) {
+         system_transfer( get_self(), vpay_account, asset(to_per_vote_pay, core_symbol()), "fund per-vote bucket" );
+      }
+   }
+
+   void system_contract::pay_producer( const producer_info& prod, const time_point& ct, bool claimed_by_owner ) {
+      const name owner = prod.owner;
 
       /// New metric to be used in pervote pay calculation. Instead of vote weight ratio, we combine vote weight and
       /// time duration the vote weight has been held into one metric.
@@ -124,31 +221,51 @@ namespace eosiosystem {
 
       bool crossed_threshold       = (last_claim_plus_3days <= ct);
       bool updated_after_threshold = true;
-      if ( prod2 != _producers2.end() ) {
-         updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-      } else {
-         prod2 = _producers2.emplace( owner, [&]( producer_info2& info  ) {
-            info.owner                     = owner;
-            info.last_votepay_share_update = ct;
-         });
-      }
+      double new_votepay_share     = 0.0;
 
-      // Note: updated_after_threshold implies cross_threshold (except if claiming rewards when the producers2 table row did not exist).
+      // Note: updated_after_threshold implies cross_threshold (except if claiming rewards when the producers2 table row
+      // or, from revision 4, the votepay checkpoint did not exist).
       // The exception leads to updated_after_threshold to be treated as true regardless of whether the threshold was crossed.
       // This is okay because in this case the producer will not get paid anything either way.
       // In fact it is desired behavior because the producers votes need to be counted in the global total_producer_votepay_share for the first time.
 
+      std::optional<producer_votepay_checkpoint> checkpoint;
+      /// the checkpoint is only moved into the producers row, which the producer pays for, when the producer claims
+      const bool checkpoint_in_row = prod.votepay_checkpoint.has_value() || ( claimed_by_owner && prod.producer_authority.has_value() );
+      if( _gstate2.revision >= 4 ) {
+         checkpoint = get_votepay_checkpoint( prod );
+         if( checkpoint ) {
+            updated_after_threshold = (last_claim_plus_3days <= checkpoint->last_votepay_share_update);
+         } else {
+            checkpoint.emplace();
+            checkpoint->last_votepay_share_update = ct;
+         }
+         new_votepay_share = checkpoint->update( ct,
+                                updated_after_threshold ? 0.0 : prod.total_votes,
+                                true // reset votepay_share to zero after updating
+                             );
+      } else {
+         auto prod2 = _producers2.find( owner.value );
+         if ( prod2 != _producers2.end() ) {
+            updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
+         } else {
+            prod2 = _producers2.emplace( claimed_by_owner ? owner : get_self(), [&]( producer_info2& info  ) {
+               info.owner                     = owner;
+               info.last_votepay_share_update = ct;
+            });
+         }
+         new_votepay_share = update_producer_votepay_share( prod2,
+                                ct,
+                                updated_after_threshold ? 0.0 : prod.total_votes,
+                                true // reset votepay_share to zero after updating
+                             );
+      }
+
       int64_t producer_per_block_pay = 0;
       if( _gstate.total_unpaid_blocks > 0 ) {
          producer_per_block_pay = (_gstate.perblock_bucket * prod.unpaid_blocks) / _gstate.total_unpaid_blocks;
       }
 
-      double new_votepay_share = update_producer_votepay_share( prod2,
-                                    ct,
-                                    updated_after_threshold ? 0.0 : prod.total_votes,
-                                    true // reset votepay_share to zero after updating
-                                 );
-
       int64_t producer_per_vote_pay = 0;
       if( _gstate2.revision > 0 ) {
          double total_votepay_share = update_total_votepay_share( ct );
@@ -176,15 +293,95 @@ namespace eosiosystem {
       _producers.modify( prod, same_payer, [&](auto& p) {
          p.last_claim_time = ct;
          p.unpaid_blocks   = 0;
+         if( checkpoint && checkpoint_in_row ) {
+            p.votepay_checkpoint.emplace( *checkpoint );
+         }
       });
+      if( checkpoint ) {
+         if( checkpoint_in_row ) {
+            erase_producer2( owner );
+         } else {
+            set_producer2_checkpoint( owner, *checkpoint, claimed_by_owner ? owner : get_self() );
+         }
+      }
 
       if ( producer_per_block_pay > 0 ) {
-         token::transfer_action transfer_act{ token_account, { {bpay_account, active_permission}, {owner, active_permission} } };
-         transfer_act.send( bpay_account, owner, asset(producer_per_block_pay, core_symbol()), "producer block pay" );
+         if( claimed_by_owner ) {
+            token::transfer_action transfer_act{ token_account, { {bpay_account, active_permission}, {owner, active_permission} } };
+            transfer_act.send( bpay_account, owner, asset(producer_per_block_pay, core_symbol()), "producer block pay" );
+         } else {
+            system_payout( bpay_account, owner, asset(producer_per_block_pay, core_symbol()), "producer block pay" );
+         }
       }
       if ( producer_per_vote_pay > 0 ) {
-         token::transfer_action transfer_act{ token_account, { {vpay_account, active_permission}, {owner, active_permission} } };
-         transfer_act.send( vpay_account, owner, asset(producer_per_vote_pay, core_symbol()), "producer vote pay" );
+         if( claimed_by_owner ) {
+            token::transfer_action transfer_act{ token_account, { {vpay_account, active_permission}, {owner, active_permission} } };
+            transfer_act.send( vpay_account, owner, asset(producer_per_vote_pay, core_symbol()), "producer vote pay" );
+         } else {
+            system_payout( vpay_account, owner, asset(producer_per_vote_pay, core_symbol()), "producer vote pay" );
+         }
+      }
+   }
+
+   void system_contract::claimrewards( const name& owner ) {
+      require_auth( owner );
+
+      if( _gstate2.revision >= 2 ) {
+         fold_unpaid_blocks();
+      }
+
+      const auto& prod = _producers.get( owner.value );
+      check( prod.active(), "producer does not have an active key" );
+
+      check( _gstate.thresh_activated_stake_time != time_point(),
+                    "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
+
+      const auto ct = current_time_point();
+
+      check( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
+
+      if( _gstate2.revision < 3 ) {
+         fill_reward_buckets( ct );
+      } else {
+         issue_accrued_inflation();
+      }
+      pay_producer( prod, ct, true );
+   }
+
+   void system_contract::settlerewards( const name& user, const name& lower_bound, uint16_t max ) {
+      require_auth( user );
+
+      check( _gstate.thresh_activated_stake_time != time_point(),
+                    "cannot settle rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
+
+      if( _gstate2.revision >= 2 ) {
+         fold_unpaid_blocks();
+      }
+
+      const auto ct = current_time_point();
+
+      /**
+       * Inflation is issued once for the whole batch, as accrued by onblock from revision 3. At most `max`
+       * active producers are visited, from the highest total votes to the lowest starting at `lower_bound`,
+       * whether they are paid or not; only those with unpaid blocks that have not claimed within the past day
+       * are paid, so standby producers keep accumulating their vote pay until they claim it themselves.
+       * Payouts are made without notifying the producers from revision 5, so one producer cannot abort the batch.
+       */
+      if( _gstate2.revision < 3 ) {
+         fill_reward_buckets( ct );
+      } else {
+         issue_accrued_inflation();
+      }
+
+      auto idx = _producers.get_index<"prototalvote"_n>();
+      auto it = idx.cbegin();
+      if( lower_bound ) {
+         it = idx.iterator_to( _producers.get( lower_bound.value, "producer not found" ) );
+      }
+      for( uint16_t visited = 0; it != idx.cend() && it->active() && visited < max; ++it, ++visited ) {
+         if( it->unpaid_blocks == 0 || ct - it->last_claim_time <= microseconds(useconds_per_day) )
+            continue;
+         pay_producer( *it, ct, false );
       }
    }
 
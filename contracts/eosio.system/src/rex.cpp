@@ -72,6 +72,7 @@ namespace eosiosystem {
             dbw.net_weight.amount -= from_net.amount;
             dbw.cpu_weight.amount -= from_cpu.amount;
          });
+         update_inbound_delegation( owner, receiver, del_itr->net_weight, del_itr->cpu_weight );
          if ( del_itr->is_empty() ) {
             dbw_table.erase( del_itr );
          }
@@ -81,10 +82,7 @@ namespace eosiosystem {
 
       const asset payment = from_net + from_cpu;
       // inline transfer from stake_account to rex_account
-      {
-         token::transfer_action transfer_act{ token_account, { stake_account, active_permission } };
-         transfer_act.send( stake_account, rex_account, payment, "buy REX with staked tokens" );
-      }
+      system_transfer( stake_account, rex_account, payment, "buy REX with staked tokens" );
       const asset rex_received = add_to_rex_pool( payment );
       add_to_rex_balance( owner, payment, rex_received );
       runrex(2);
@@ -923,11 +921,35 @@ namespace eosiosystem {
       if ( rex_available() ) {
          add_to_rex_return_pool( amount );
          // inline transfer to rex_account
-         token::transfer_action transfer_act{ token_account, { from, active_permission } };
-         transfer_act.send( from, rex_account, amount,
-                            std::string("transfer from ") + from.to_string() + " to eosio.rex" );
+         system_transfer( from, rex_account, amount, std::string("transfer from ") + from.to_string() + " to eosio.rex" );
+      }
+#endif
+   }
+
+   /**
+    * @brief Channels a RAM trading fee paid by `payer` to REX pool
+    *
+    * If ROUTE_RAM_FEES_DIRECTLY_TO_REX is set and REX is available, the fee is transferred by
+    * `payer` straight to eosio.rex, saving the intermediate eosio.token transfer through eosio.ramfee.
+    * Otherwise, the fee is transferred to eosio.ramfee and then channeled to REX as before.
+    *
+    * @param payer - account paying the fee
+    * @param fee - amount of tokens to be transfered
+    * @param memo - memo of the fee transfer
+    */
+   void system_contract::channel_ram_fee_to_rex( const name& payer, const asset& fee, const std::string& memo )
+   {
+#if CHANNEL_RAM_AND_NAMEBID_FEES_TO_REX && ROUTE_RAM_FEES_DIRECTLY_TO_REX
+      if ( rex_available() ) {
+         add_to_rex_return_pool( fee );
+         token::transfer_action transfer_act{ token_account, { payer, active_permission } };
+         transfer_act.send( payer, rex_account, fee, memo );
+         return;
       }
 #endif
+      token::transfer_action transfer_act{ token_account, { payer, active_permission } };
+      transfer_act.send( payer, ramfee_account, fee, memo );
+      channel_to_rex( ramfee_account, fee );
    }
 
    /**
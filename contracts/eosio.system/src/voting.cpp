@@ -37,7 +37,26 @@ namespace eosiosystem {
          }
       }, producer_authority );
 
-      if ( prod != _producers.end() ) {
+      if ( prod != _producers.end() && _gstate2.revision >= 4 ) {
+         auto checkpoint = get_votepay_checkpoint( *prod );
+         if ( !checkpoint ) {
+            checkpoint.emplace();
+            checkpoint->last_votepay_share_update = ct;
+            update_total_votepay_share( ct, 0.0, prod->total_votes );
+            // When introducing the votepay checkpoint for the first time, the producer's votes must also be accounted for in the global total_producer_votepay_share at the same time.
+         }
+         _producers.modify( prod, producer, [&]( producer_info& info ){
+            info.producer_key       = producer_key;
+            info.is_active          = true;
+            info.url                = url;
+            info.location           = location;
+            info.producer_authority.emplace( producer_authority );
+            info.votepay_checkpoint.emplace( *checkpoint );
+            if ( info.last_claim_time == time_point() )
+               info.last_claim_time = ct;
+         });
+         erase_producer2( producer );
+      } else if ( prod != _producers.end() ) {
          _producers.modify( prod, producer, [&]( producer_info& info ){
             info.producer_key       = producer_key;
             info.is_active          = true;
@@ -67,11 +86,17 @@ namespace eosiosystem {
             info.location           = location;
             info.last_claim_time    = ct;
             info.producer_authority.emplace( producer_authority );
+            if ( _gstate2.revision >= 4 ) {
+               info.votepay_checkpoint.emplace();
+               info.votepay_checkpoint->last_votepay_share_update = ct;
+            }
          });
-         _producers2.emplace( producer, [&]( producer_info2& info ){
-            info.owner                     = producer;
-            info.last_votepay_share_update = ct;
-         });
+         if ( _gstate2.revision < 4 ) {
+            _producers2.emplace( producer, [&]( producer_info2& info ){
+               info.owner                     = producer;
+               info.last_votepay_share_update = ct;
+            });
+         }
       }
 
    }
@@ -98,11 +123,38 @@ namespace eosiosystem {
       require_auth( producer );
 
       const auto& prod = _producers.get( producer.value, "producer not found" );
+      if ( prod.votepay_checkpoint.has_value() ) {
+         set_producer2_checkpoint( producer, *prod.votepay_checkpoint, producer );
+      }
       _producers.modify( prod, same_payer, [&]( producer_info& info ){
          info.deactivate();
       });
    }
 
+   void system_contract::migratevpay( const name& user, const name& lower_bound, uint16_t max ) {
+      require_auth( user );
+      check( _gstate2.revision >= 4, "votepay checkpoints can only be migrated from revision 4" );
+
+      auto it = _producers2.lower_bound( lower_bound.value );
+      for( uint16_t visited = 0; it != _producers2.end() && visited < max; ++visited ) {
+         auto prod = _producers.find( it->owner.value );
+         // the checkpoint of an unregistered producer can not be stored in its row, which has no producer authority
+         if( prod == _producers.end() || !prod->active() ) {
+            ++it;
+            continue;
+         }
+         _producers.modify( prod, get_self(), [&]( producer_info& info ) {
+            if( !info.producer_authority.has_value() ) {
+               info.producer_authority.emplace( convert_to_block_signing_authority( info.producer_key ) );
+            }
+            if( !info.votepay_checkpoint.has_value() ) {
+               info.votepay_checkpoint.emplace( producer_votepay_checkpoint{ it->votepay_share, it->last_votepay_share_update } );
+            }
+         });
+         it = _producers2.erase( it );
+      }
+   }
+
    void system_contract::update_elected_producers( const block_timestamp& block_time ) {
       _gstate.last_producer_schedule_update = block_time;
 
@@ -199,6 +251,82 @@ namespace eosiosystem {
       return new_votepay_share;
    }
 
+   std::optional<producer_votepay_checkpoint> system_contract::get_votepay_checkpoint( const producer_info& prod ) {
+      if( prod.votepay_checkpoint.has_value() ) {
+         return *prod.votepay_checkpoint;
+      }
+
+      auto prod2 = _producers2.find( prod.owner.value );
+      if( prod2 == _producers2.end() ) {
+         return {};
+      }
+      return producer_votepay_checkpoint{ prod2->votepay_share, prod2->last_votepay_share_update };
+   }
+
+   void system_contract::set_producer2_checkpoint( const name& owner, const producer_votepay_checkpoint& checkpoint, const name& payer ) {
+      auto prod2 = _producers2.find( owner.value );
+      if( prod2 == _producers2.end() ) {
+         _producers2.emplace( payer, [&]( producer_info2& info ) {
+            info.owner                     = owner;
+            info.votepay_share             = checkpoint.votepay_share;
+            info.last_votepay_share_update = checkpoint.last_votepay_share_update;
+         });
+      } else {
+         _producers2.modify( prod2, same_payer, [&]( producer_info2& info ) {
+            info.votepay_share             = checkpoint.votepay_share;
+            info.last_votepay_share_update = checkpoint.last_votepay_share_update;
+         });
+      }
+   }
+
+   void system_contract::erase_producer2( const name& owner ) {
+      auto prod2 = _producers2.find( owner.value );
+      if( prod2 != _producers2.end() ) {
+         _producers2.erase( prod2 );
+      }
+   }
+
+   void system_contract::update_producer_votes( const producer_info& prod, double delta, const time_point& ct,
+                                                double& delta_change_rate, double& total_inactive_vpay_share )
+   {
+      const double init_total_votes = prod.total_votes;
+      /// voters never move a checkpoint into the producers row, which would grow a row paid by the producer
+      const bool checkpoint_in_row = prod.votepay_checkpoint.has_value();
+      auto checkpoint = get_votepay_checkpoint( prod );
+      if( checkpoint ) {
+         const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
+         bool crossed_threshold       = (last_claim_plus_3days <= ct);
+         bool updated_after_threshold = (last_claim_plus_3days <= checkpoint->last_votepay_share_update);
+         // Note: updated_after_threshold implies cross_threshold
+
+         double new_votepay_share = checkpoint->update( ct,
+                                       updated_after_threshold ? 0.0 : init_total_votes,
+                                       crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
+                                    );
+
+         if( !crossed_threshold ) {
+            delta_change_rate += delta;
+         } else if( !updated_after_threshold ) {
+            total_inactive_vpay_share += new_votepay_share;
+            delta_change_rate -= init_total_votes;
+         }
+      }
+
+      _producers.modify( prod, same_payer, [&]( auto& p ) {
+         p.total_votes += delta;
+         if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+            p.total_votes = 0;
+         }
+         _gstate.total_producer_vote_weight += delta;
+         if( checkpoint_in_row ) {
+            p.votepay_checkpoint.emplace( *checkpoint );
+         }
+      });
+      if( checkpoint && !checkpoint_in_row ) {
+         set_producer2_checkpoint( prod.owner, *checkpoint, prod.owner );
+      }
+   }
+
    void system_contract::voteproducer( const name& voter_name, const name& proxy, const std::vector<name>& producers ) {
       require_auth( voter_name );
       vote_stake_updater( voter_name );
@@ -289,6 +417,10 @@ namespace eosiosystem {
             if( voting && !pitr->active() && pd.second.second /* from new set */ ) {
                check( false, ( "producer " + pitr->owner.to_string() + " is not currently registered" ).data() );
             }
+            if( _gstate2.revision >= 4 ) {
+               update_producer_votes( *pitr, pd.second.first, ct, delta_change_rate, total_inactive_vpay_share );
+               continue;
+            }
             double init_total_votes = pitr->total_votes;
             _producers.modify( pitr, same_payer, [&]( auto& p ) {
                p.total_votes += pd.second.first;
@@ -325,7 +457,10 @@ namespace eosiosystem {
          }
       }
 
-      update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      /// from revision 4 the global votepay state is left as is when no producer's share rate changes
+      if( _gstate2.revision < 4 || delta_change_rate != 0.0 || total_inactive_vpay_share != 0.0 ) {
+         update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      }
 
       _voters.modify( voter, same_payer, [&]( auto& av ) {
          av.last_vote_weight = new_vote_weight;
@@ -360,7 +495,7 @@ namespace eosiosystem {
          new_weight += voter.proxied_vote_weight;
       }
 
-      /// don't propagate small changes (1 ~= epsilon)
+      /// don't propagate small changes (1 ~= epsilon), last_vote_weight is kept so that they accumulate
       if ( fabs( new_weight - voter.last_vote_weight ) > 1 )  {
          if ( voter.proxy ) {
             auto& proxy = _voters.get( voter.proxy.value, "proxy not found" ); //data corruption
@@ -376,9 +511,16 @@ namespace eosiosystem {
             double total_inactive_vpay_share = 0;
             for ( auto acnt : voter.producers ) {
                auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
+               if( _gstate2.revision >= 4 ) {
+                  update_producer_votes( prod, delta, ct, delta_change_rate, total_inactive_vpay_share );
+                  continue;
+               }
                const double init_total_votes = prod.total_votes;
                _producers.modify( prod, same_payer, [&]( auto& p ) {
                   p.total_votes += delta;
+                  if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+                     p.total_votes = 0;
+                  }
                   _gstate.total_producer_vote_weight += delta;
                });
                auto prod2 = _producers2.find( acnt.value );
@@ -403,13 +545,15 @@ namespace eosiosystem {
                }
             }
 
-            update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+            if( _gstate2.revision < 4 || delta_change_rate != 0.0 || total_inactive_vpay_share != 0.0 ) {
+               update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+            }
          }
+         _voters.modify( voter, same_payer, [&]( auto& v ) {
+               v.last_vote_weight = new_weight;
+            }
+         );
       }
-      _voters.modify( voter, same_payer, [&]( auto& v ) {
-            v.last_vote_weight = new_weight;
-         }
-      );
    }
 
 } /// namespace eosiosystem
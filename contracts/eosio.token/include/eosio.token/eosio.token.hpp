@@ -4,6 +4,7 @@
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -13,6 +14,23 @@ namespace eosio {
 
    using std::string;
 
+   /**
+    * A single transfer of a `transfers` batch, or a single issue of an `issuemany` batch.
+    */
+   struct token_transfer {
+      name     to;
+      asset    quantity;
+      string   memo;
+   };
+
+   /**
+    * A single (owner, token) pair of a `getbalances` query.
+    */
+   struct balance_query {
+      name          owner;
+      symbol_code   sym_code;
+   };
+
    /**
     * eosio.token contract defines the structures and actions that allow users to create, issue, and manage
     * tokens on EOSIO based blockchains.
@@ -45,6 +63,20 @@ namespace eosio {
          [[eosio::action]]
          void issue( const name& to, const asset& quantity, const string& memo );
 
+         /**
+          * This action issues tokens to several accounts in one action.
+          * The supply is increased once with the total quantity, which is credited to the issuer,
+          * and each quantity is then sent from the issuer to its recipient as an inline `transfer` action.
+          *
+          * @param issues - the list of recipients, quantities and memos to be issued.
+          *
+          * @pre All quantities have to be of the same token,
+          * @pre The total quantity must not exceed the available supply,
+          * @pre The active permission of the issuer has to be satisfied by the `eosio.code` permission of this contract.
+          */
+         [[eosio::action]]
+         void issuemany( const std::vector<token_transfer>& issues );
+
          /**
           * The opposite for create action, if all validations succeed,
           * it debits the statstable.supply amount.
@@ -69,6 +101,56 @@ namespace eosio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Allows `from` account to transfer tokens to several accounts in one action.
+          * Each transfer of the batch is sent as an inline `transfer` action, so `from` and every
+          * recipient are notified of a `transfer` exactly as if it had been sent on its own.
+          *
+          * @param from - the account to transfer from,
+          * @param transfers - the list of recipients, quantities and memos to be transferred.
+          *
+          * @pre The active permission of `from` has to be satisfied by the `eosio.code` permission of this contract,
+          * @pre Every transfer has to satisfy the preconditions of `transfer`.
+          */
+         [[eosio::action]]
+         void transfers( const name& from, const std::vector<token_transfer>& transfers );
+
+         /**
+          * System payout action, pays `quantity` tokens out of the system account `from` to `to` on behalf
+          * of the system contract. It requires the authority of both `eosio` and `from`. No party is notified,
+          * so that a recipient can not abort the batch of payouts the system contract makes it part of.
+          *
+          * @param from - the system account to pay from,
+          * @param to - the account to be paid,
+          * @param quantity - the quantity of tokens to be paid,
+          * @param memo - the memo string to accompany the transaction.
+          *
+          * @pre `from` has to be a system account (`eosio` or `eosio.*`).
+          */
+         [[eosio::action]]
+         void syspayout( const name&    from,
+                         const name&    to,
+                         const asset&   quantity,
+                         const string&  memo );
+
+         /**
+          * System transfer action, a `transfer` reserved to the system contract for its internal token movements.
+          * It requires the authority of both `eosio` and `from`. Unlike `transfer`, system accounts
+          * (`eosio` and `eosio.*`) are neither notified nor checked for existence; any other party is still
+          * notified as with `transfer`.
+          *
+          * @param from - the account to transfer from,
+          * @param to - the account to be transferred to,
+          * @param quantity - the quantity of tokens to be transferred,
+          * @param memo - the memo string to accompany the transaction.
+          */
+         [[eosio::action]]
+         void systransfer( const name&    from,
+                           const name&    to,
+                           const asset&   quantity,
+                           const string&  memo );
+
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -83,6 +165,19 @@ namespace eosio {
          [[eosio::action]]
          void open( const name& owner, const symbol& symbol, const name& ram_payer );
 
+         /**
+          * Allows `ram_payer` to create zero balances for token `symbol` for several `owners`
+          * at the expense of `ram_payer`, as with `open`. Owners that already have a balance are skipped.
+          *
+          * @param owners - the accounts to be created,
+          * @param symbol - the token to be payed with by `ram_payer`,
+          * @param ram_payer - the account that supports the cost of this action.
+          *
+          * @pre `owners` can not be empty.
+          */
+         [[eosio::action]]
+         void openmany( const std::vector<name>& owners, const symbol& symbol, const name& ram_payer );
+
          /**
           * This action is the opposite for open, it closes the account `owner`
           * for token `symbol`.
@@ -96,6 +191,45 @@ namespace eosio {
          [[eosio::action]]
          void close( const name& owner, const symbol& symbol );
 
+         /**
+          * This action closes the zero balances of token `symbol` for several `owners`, as with `close`.
+          *
+          * @param owners - the owner accounts to execute the close action for,
+          * @param symbol - the symbol of the token to execute the close action for.
+          *
+          * @pre `owners` can not be empty,
+          * @pre Every owner has to authorize this action,
+          * @pre The balance of every owner has to exist and to be zero.
+          */
+         [[eosio::action]]
+         void closemany( const std::vector<name>& owners, const symbol& symbol );
+
+         /**
+          * Reads the balances of a list of (owner, token) pairs. The action does not modify any state;
+          * the balances are returned, in the order of `queries`, as the data of an inline `balances`
+          * action that appears in its trace. An owner without a balance row is reported with a zero balance.
+          *
+          * Since `balances` requires no authorization, anyone can push one with arbitrary data. Off-chain
+          * consumers must only trust a `balances` action that appears as an inline action in the trace
+          * of the `getbalances` they sent, never a top-level one.
+          *
+          * @param queries - the list of owners and token symbol codes to be read.
+          *
+          * @pre Every token in `queries` has to exist.
+          */
+         [[eosio::action]]
+         void getbalances( const std::vector<balance_query>& queries );
+
+         /**
+          * Balances action, a no-op inline convenience action sent by `getbalances`.
+          * Its data includes the result of `getbalances` and appears in its trace.
+          * It can also be pushed by anyone with any data, so it is only meaningful as an inline action of `getbalances`.
+          *
+          * @param balances - the balances read by `getbalances`.
+          */
+         [[eosio::action]]
+         void balances( const std::vector<asset>& balances );
+
          static asset get_supply( const name& token_contract_account, const symbol_code& sym_code )
          {
             stats statstable( token_contract_account, sym_code.raw() );
@@ -112,10 +246,18 @@ namespace eosio {
 
          using create_action = eosio::action_wrapper<"create"_n, &token::create>;
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
+         using issuemany_action = eosio::action_wrapper<"issuemany"_n, &token::issuemany>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using syspayout_action = eosio::action_wrapper<"syspayout"_n, &token::syspayout>;
+         using systransfer_action = eosio::action_wrapper<"systransfer"_n, &token::systransfer>;
+         using transfers_action = eosio::action_wrapper<"transfers"_n, &token::transfers>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
+         using openmany_action = eosio::action_wrapper<"openmany"_n, &token::openmany>;
+         using closemany_action = eosio::action_wrapper<"closemany"_n, &token::closemany>;
+         using getbalances_action = eosio::action_wrapper<"getbalances"_n, &token::getbalances>;
+         using balances_action = eosio::action_wrapper<"balances"_n, &token::balances>;
       private:
          struct [[eosio::table]] account {
             asset    balance;
@@ -131,11 +273,14 @@ namespace eosio {
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
 
+         static constexpr name system_account = "eosio"_n;
+
          typedef eosio::multi_index< "accounts"_n, account > accounts;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
 
          void sub_balance( const name& owner, const asset& value );
          void add_balance( const name& owner, const asset& value, const name& ram_payer );
+         static bool is_system_account( const name& account );
    };
 
 }
@@ -50,6 +50,47 @@ void token::issue( const name& to, const asset& quantity, const string& memo )
     add_balance( st.issuer, quantity, st.issuer );
 }
 
+void token::issuemany( const std::vector<token_transfer>& issues )
+{
+    check( !issues.empty(), "no issues specified" );
+    auto sym = issues.front().quantity.symbol;
+    check( sym.is_valid(), "invalid symbol name" );
+
+    stats statstable( get_self(), sym.code().raw() );
+    auto existing = statstable.find( sym.code().raw() );
+    check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
+    const auto& st = *existing;
+
+    require_auth( st.issuer );
+
+    asset total( 0, st.supply.symbol );
+    for( const auto& i : issues ) {
+        check( is_account( i.to ), "to account does not exist" );
+        check( i.quantity.is_valid(), "invalid quantity" );
+        check( i.quantity.amount > 0, "must issue positive quantity" );
+        check( i.quantity.symbol.code() == sym.code(), "all issues must be of the same token" );
+        check( i.quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+        check( i.memo.size() <= 256, "memo has more than 256 bytes" );
+
+        total += i.quantity;
+    }
+    check( total.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+
+    statstable.modify( st, same_payer, [&]( auto& s ) {
+       s.supply += total;
+    });
+
+    add_balance( st.issuer, total, st.issuer );
+
+    // same as issue followed by a transfer, so that deposit watchers see a regular transfer for every recipient
+    transfer_action transfer_act{ get_self(), { {st.issuer, "active"_n} } };
+    for( const auto& i : issues ) {
+        if( i.to != st.issuer ) {
+            transfer_act.send( st.issuer, i.to, i.quantity, i.memo );
+        }
+    }
+}
+
 void token::retire( const asset& quantity, const string& memo )
 {
     auto sym = quantity.symbol;
@@ -82,16 +123,73 @@ void token::transfer( const name&    from,
     check( from != to, "cannot transfer to self" );
     require_auth( from );
     check( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( get_self(), sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
 
     require_recipient( from );
     require_recipient( to );
 
     check( quantity.is_valid(), "invalid quantity" );
     check( quantity.amount > 0, "must transfer positive quantity" );
-    check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    // the precision is checked by sub_balance against the sender's balance, whose symbol was taken from the token stats
+
+    auto payer = has_auth( to ) ? to : from;
+
+    sub_balance( from, quantity );
+    add_balance( to, quantity, payer );
+}
+
+void token::transfers( const name& from, const std::vector<token_transfer>& transfers )
+{
+    require_auth( from );
+    check( !transfers.empty(), "no transfers specified" );
+
+    // every leg is a regular transfer, so that contracts listening to transfer notifications see each of them
+    transfer_action transfer_act{ get_self(), { {from, "active"_n} } };
+    for( const auto& t : transfers ) {
+        transfer_act.send( from, t.to, t.quantity, t.memo );
+    }
+}
+
+void token::syspayout( const name&    from,
+                       const name&    to,
+                       const asset&   quantity,
+                       const string&  memo )
+{
+    check( from != to, "cannot transfer to self" );
+    check( is_system_account( from ), "payouts can only be made from a system account" );
+    require_auth( system_account );
+    require_auth( from );
+    check( is_account( to ), "to account does not exist");
+
+    check( quantity.is_valid(), "invalid quantity" );
+    check( quantity.amount > 0, "must transfer positive quantity" );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    sub_balance( from, quantity );
+    add_balance( to, quantity, from );
+}
+
+void token::systransfer( const name&    from,
+                         const name&    to,
+                         const asset&   quantity,
+                         const string&  memo )
+{
+    check( from != to, "cannot transfer to self" );
+    require_auth( system_account );
+    require_auth( from );
+
+    // system accounts have no code listening to transfers, so they are not notified
+    if( !is_system_account( from ) ) {
+        require_recipient( from );
+    }
+    if( !is_system_account( to ) ) {
+        check( is_account( to ), "to account does not exist");
+        require_recipient( to );
+    }
+
+    check( quantity.is_valid(), "invalid quantity" );
+    check( quantity.amount > 0, "must transfer positive quantity" );
     check( memo.size() <= 256, "memo has more than 256 bytes" );
 
     auto payer = has_auth( to ) ? to : from;
@@ -104,6 +202,7 @@ void token::sub_balance( const name& owner, const asset& value ) {
    accounts from_acnts( get_self(), owner.value );
 
    const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
+   check( from.balance.symbol == value.symbol, "symbol precision mismatch" );
    check( from.balance.amount >= value.amount, "overdrawn balance" );
 
    from_acnts.modify( from, owner, [&]( auto& a ) {
@@ -126,6 +225,11 @@ void token::add_balance( const name& owner, const asset& value, const name& ram_
    }
 }
 
+bool token::is_system_account( const name& account )
+{
+   return account == system_account || account.prefix() == system_account;
+}
+
 void token::open( const name& owner, const symbol& symbol, const name& ram_payer )
 {
    require_auth( ram_payer );
@@ -146,6 +250,29 @@ void token::open( const name& owner, const symbol& symbol, const name& ram_payer
    }
 }
 
+void token::openmany( const std::vector<name>& owners, const symbol& symbol, const name& ram_payer )
+{
+   require_auth( ram_payer );
+   check( !owners.empty(), "no owners specified" );
+
+   auto sym_code_raw = symbol.code().raw();
+   stats statstable( get_self(), sym_code_raw );
+   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
+   check( st.supply.symbol == symbol, "symbol precision mismatch" );
+
+   for( const auto& owner : owners ) {
+      check( is_account( owner ), "owner account does not exist" );
+
+      accounts acnts( get_self(), owner.value );
+      auto it = acnts.find( sym_code_raw );
+      if( it == acnts.end() ) {
+         acnts.emplace( ram_payer, [&]( auto& a ){
+           a.balance = asset{0, symbol};
+         });
+      }
+   }
+}
+
 void token::close( const name& owner, const symbol& symbol )
 {
    require_auth( owner );
@@ -156,4 +283,39 @@ void token::close( const name& owner, const symbol& symbol )
    acnts.erase( it );
 }
 
+void token::closemany( const std::vector<name>& owners, const symbol& symbol )
+{
+   check( !owners.empty(), "no owners specified" );
+   for( const auto& owner : owners ) {
+      require_auth( owner );
+      accounts acnts( get_self(), owner.value );
+      auto it = acnts.find( symbol.code().raw() );
+      check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
+      check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
+      acnts.erase( it );
+   }
+}
+
+void token::getbalances( const std::vector<balance_query>& queries )
+{
+   std::vector<asset> result;
+   result.reserve( queries.size() );
+   for( const auto& q : queries ) {
+      accounts acnts( get_self(), q.owner.value );
+      auto it = acnts.find( q.sym_code.raw() );
+      if( it != acnts.end() ) {
+         result.push_back( it->balance );
+      } else {
+         stats statstable( get_self(), q.sym_code.raw() );
+         const auto& st = statstable.get( q.sym_code.raw(), "symbol does not exist" );
+         result.emplace_back( 0, st.supply.symbol );
+      }
+   }
+
+   balances_action balances_act{ get_self(), std::vector<eosio::permission_level>{ } };
+   balances_act.send( result );
+}
+
+void token::balances( const std::vector<asset>& balances ) { }
+
 } /// namespace eosio
@@ -36,7 +36,23 @@ namespace eosio {
          [[eosio::action]]
          void exec( ignore<name> executer, ignore<transaction> trx );
 
+         /**
+          * Execute inline action.
+          *
+          * Execute a transaction while bypassing regular authorization checks, as with `exec`, except that
+          * the actions of `trx` are sent as inline actions of this action instead of as a deferred transaction.
+          *
+          * @param executer - account executing the transaction,
+          * @param trx - the transaction to be executed.
+          *
+          * @pre Requires authorization of eosio.wrap which needs to be a privileged account.
+          * @pre `trx` can have neither a delay nor context-free actions.
+          */
+         [[eosio::action]]
+         void execinline( ignore<name> executer, ignore<transaction> trx );
+
          using exec_action = eosio::action_wrapper<"exec"_n, &wrap::exec>;
+         using execinline_action = eosio::action_wrapper<"execinline"_n, &wrap::execinline>;
    };
    /** @}*/ // end of @defgroup eosiowrap eosio.wrap
 } /// namespace eosio
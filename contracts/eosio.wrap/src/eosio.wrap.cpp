@@ -1,5 +1,7 @@
 #include <eosio.wrap/eosio.wrap.hpp>
 
+#include <eosio/privileged.hpp>
+
 namespace eosio {
 
 void wrap::exec( ignore<name>, ignore<transaction> ) {
@@ -13,4 +15,22 @@ void wrap::exec( ignore<name>, ignore<transaction> ) {
    send_deferred( (uint128_t(executer.value) << 64) | (uint64_t)current_time_point().time_since_epoch().count(), executer, _ds.pos(), _ds.remaining() );
 }
 
+void wrap::execinline( ignore<name>, ignore<transaction> ) {
+   require_auth( get_self() );
+
+   name executer;
+   transaction trx;
+   _ds >> executer >> trx;
+
+   require_auth( executer );
+
+   // inline actions of a privileged contract are not checked against their authorizations
+   check( is_privileged( get_self() ), "inline execution requires a privileged contract" );
+   check( trx.delay_sec.value == 0, "inline execution requires a transaction without delay" );
+   check( trx.context_free_actions.empty(), "inline execution does not support context-free actions" );
+   for ( const auto& act : trx.actions ) {
+      act.send();
+   }
+}
+
 } /// namespace eosio
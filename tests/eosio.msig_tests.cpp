@@ -999,4 +999,672 @@ BOOST_FIXTURE_TEST_CASE( switch_proposal_and_fail_approve_with_hash, eosio_msig_
    );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( proposal_digest, eosio_msig_tester ) try {
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   auto trx_hash = fc::sha256::hash( trx );
+
+   for ( auto proposer : { N(alice), N(bob) } ) {
+      push_action( proposer, N(propose), mvo()
+                     ("proposer",      proposer)
+                     ("proposal_name", "first")
+                     ("trx",           trx)
+                     ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+      );
+   }
+
+   // every proposal keeps its own copy of the transaction, and its digest is kept in its expiry row
+   uint64_t id = 0;
+   for ( auto proposer : { N(alice), N(bob) } ) {
+      auto prop = abi_ser.binary_to_variant( "proposal", get_row_by_account( N(eosio.msig), proposer, N(proposal), N(first) ), abi_serializer_max_time );
+      BOOST_REQUIRE( fc::raw::pack( trx ) == prop["packed_transaction"].as<bytes>() );
+      BOOST_REQUIRE( !prop.get_object().contains( "trx_hash" ) );
+      auto expiry = abi_ser.binary_to_variant( "proposal_expiry", get_row_by_account( N(eosio.msig), N(eosio.msig), N(expiries), account_name(id++) ), abi_serializer_max_time );
+      BOOST_REQUIRE_EQUAL( proposer, expiry["proposer"].as<account_name>() );
+      BOOST_REQUIRE_EQUAL( string(trx_hash), expiry["trx_hash"].as_string() );
+   }
+
+   push_action( N(alice), N(cancel), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("canceler",      "alice")
+   );
+
+   // approving with the stored digest, and executing, are not affected by the other proposal
+   push_action( N(alice), N(approve), mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(alice), config::active_name })
+                  ("proposal_hash", trx_hash)
+   );
+
+   transaction_trace_ptr trace;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->scheduled ) { trace = t; }
+   } );
+
+   push_action( N(bob), N(exec), mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "first")
+                  ("executer",      "bob")
+   );
+
+   BOOST_REQUIRE( bool(trace) );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( chunked_propose, eosio_msig_tester ) try {
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   const bytes packed_trx = fc::raw::pack( trx );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(propappend), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("chunk",         packed_trx)
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("upload not found")
+   );
+
+   push_action( N(alice), N(propbegin), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(propfinalize), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("no transaction uploaded")
+   );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(bob), N(cancel), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("canceler",      "bob")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("only the proposer can cancel an upload")
+   );
+
+   // upload the transaction in three chunks
+   const size_t chunk_size = packed_trx.size() / 3 + 1;
+   for ( size_t pos = 0; pos < packed_trx.size(); pos += chunk_size ) {
+      push_action( N(alice), N(propappend), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", "first")
+                     ("chunk",         bytes( packed_trx.begin() + pos, packed_trx.begin() + std::min( pos + chunk_size, packed_trx.size() ) ))
+      );
+   }
+
+   push_action( N(alice), N(propfinalize), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+   );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(uploads), N(first) ).empty() );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(propbegin), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("proposal with the same name exists")
+   );
+
+   push_action( N(alice), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(alice), config::active_name })
+                  ("proposal_hash", fc::sha256::hash( trx ))
+   );
+
+   transaction_trace_ptr trace;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->scheduled ) { trace = t; }
+   } );
+
+   push_action( N(alice), N(exec), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("executer",      "alice")
+   );
+
+   BOOST_REQUIRE( bool(trace) );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+
+   // an unfinished upload can be dropped by its proposer
+   push_action( N(alice), N(propbegin), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+   push_action( N(alice), N(cancel), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("canceler",      "alice")
+   );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(uploads), N(second) ).empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( sorted_approvals, eosio_msig_tester ) try {
+   const vector<permission_level> levels{ { N(carol), config::active_name }, { N(alice), config::active_name }, { N(bob), config::active_name } };
+   auto trx = reqauth( N(alice), levels, abi_serializer_max_time );
+
+   push_action( N(alice), N(propose), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("trx",           trx)
+                  ("requested",     levels)
+   );
+
+   auto get_levels = [&]( const string& list ) {
+      auto apps = abi_ser.binary_to_variant( "approvals_info", get_row_by_account( N(eosio.msig), N(alice), N(approvals2), N(first) ), abi_serializer_max_time );
+      BOOST_REQUIRE_EQUAL( 2, apps["version"].as<uint8_t>() );
+      vector<account_name> actors;
+      for ( const auto& a : apps[list].get_array() ) {
+         actors.push_back( a["level"]["actor"].as<account_name>() );
+      }
+      return actors;
+   };
+   auto approve = [&]( account_name actor, const action_name& act ) {
+      push_action( actor, act, mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", "first")
+                     ("level",         permission_level{ actor, config::active_name })
+      );
+   };
+
+   // both lists stay sorted by permission level
+   BOOST_REQUIRE( (vector<account_name>{ N(alice), N(bob), N(carol) }) == get_levels( "requested_approvals" ) );
+   approve( N(bob), N(approve) );
+   approve( N(carol), N(approve) );
+   approve( N(alice), N(approve) );
+   BOOST_REQUIRE( get_levels( "requested_approvals" ).empty() );
+   BOOST_REQUIRE( (vector<account_name>{ N(alice), N(bob), N(carol) }) == get_levels( "provided_approvals" ) );
+
+   approve( N(bob), N(unapprove) );
+   BOOST_REQUIRE( (vector<account_name>{ N(bob) }) == get_levels( "requested_approvals" ) );
+   BOOST_REQUIRE( (vector<account_name>{ N(alice), N(carol) }) == get_levels( "provided_approvals" ) );
+
+   BOOST_REQUIRE_EXCEPTION( approve( N(bob), N(unapprove) ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("no approval previously granted")
+   );
+   BOOST_REQUIRE_EXCEPTION( approve( N(carol), N(approve) ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("approval is not on the list of requested approvals")
+   );
+
+   approve( N(bob), N(approve) );
+
+   transaction_trace_ptr trace;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->scheduled ) { trace = t; }
+   } );
+
+   push_action( N(alice), N(exec), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("executer",      "alice")
+   );
+
+   BOOST_REQUIRE( bool(trace) );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( approvemany_execute, eosio_msig_tester ) try {
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   auto trx_hash = fc::sha256::hash( trx );
+
+   for ( auto proposal_name : { N(first), N(second) } ) {
+      push_action( N(alice), N(propose), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", proposal_name)
+                     ("trx",           trx)
+                     ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+      );
+   }
+   push_action( N(bob), N(propose), mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "first")
+                  ("trx",           trx)
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(approvemany), mvo()
+                                          ("level",     permission_level{ N(alice), config::active_name })
+                                          ("proposals", vector<mvo>{})
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("no proposals specified")
+   );
+
+   //the whole batch fails if one of the approvals fails
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(approvemany), mvo()
+                                          ("level",     permission_level{ N(alice), config::active_name })
+                                          ("proposals", vector<mvo>{
+                                             mvo()("proposer", "alice")("proposal_name", "first")("proposal_hash", trx_hash),
+                                             mvo()("proposer", "alice")("proposal_name", "third")("proposal_hash", fc::variant()) })
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("proposal not found")
+   );
+
+   push_action( N(alice), N(approvemany), mvo()
+                  ("level",     permission_level{ N(alice), config::active_name })
+                  ("proposals", vector<mvo>{
+                     mvo()("proposer", "alice")("proposal_name", "first")("proposal_hash", trx_hash),
+                     mvo()("proposer", "alice")("proposal_name", "second")("proposal_hash", fc::variant()),
+                     mvo()("proposer", "bob")("proposal_name", "first")("proposal_hash", trx_hash) })
+   );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(approve), mvo()
+                                          ("proposer",      "bob")
+                                          ("proposal_name", "first")
+                                          ("level",         permission_level{ N(alice), config::active_name })
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("approval is not on the list of requested approvals")
+   );
+
+   transaction_trace_ptr trace;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->scheduled ) { trace = t; }
+   } );
+
+   push_action( N(alice), N(exec), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("executer",      "alice")
+   );
+
+   BOOST_REQUIRE( bool(trace) );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( gc_invalidations, eosio_msig_tester ) try {
+   auto get_inval = [&]( account_name account ) {
+      return get_row_by_account( N(eosio.msig), N(eosio.msig), N(invals), account );
+   };
+
+   //invalidations made before garbage collection is initialized are kept
+   push_action( N(bob), N(invalidate), mvo()
+                  ("account",      "bob")
+   );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(initgcinvals), mvo()("max_expiration", fc::time_point_sec()) ),
+                            missing_auth_exception,
+                            fc_exception_message_starts_with("missing authority")
+   );
+   push_action( N(eosio.msig), N(initgcinvals), mvo()("max_expiration", fc::time_point_sec()) );
+   BOOST_REQUIRE_EXCEPTION( push_action( N(eosio.msig), N(initgcinvals), mvo()("max_expiration", fc::time_point_sec()) ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("invalidations garbage collection is already initialized")
+   );
+
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   push_action( N(alice), N(propose), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("trx",           trx)
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+   push_action( N(alice), N(invalidate), mvo()
+                  ("account",      "alice")
+   );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 0) ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("max must be positive")
+   );
+
+   //the invalidation is kept while the proposal may still be executed
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 10) );
+   BOOST_REQUIRE( !get_inval( N(alice) ).empty() );
+   BOOST_REQUIRE( !get_inval( N(bob) ).empty() );
+
+   produce_block( fc::minutes(31) );
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 10) );
+   BOOST_REQUIRE( get_inval( N(alice) ).empty() );
+   BOOST_REQUIRE( !get_inval( N(bob) ).empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( gc_invalidations_horizon, eosio_msig_tester ) try {
+   auto get_inval = [&]( account_name account ) {
+      return get_row_by_account( N(eosio.msig), N(eosio.msig), N(invals), account );
+   };
+
+   push_action( N(eosio.msig), N(initgcinvals), mvo()("max_expiration", fc::time_point_sec()) );
+
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   auto far_trx = trx;
+   far_trx.expiration = control->head_block_time() + fc::days(1);
+   push_action( N(bob), N(propose), mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "far")
+                  ("trx",           far_trx)
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+   //bob's invalidation is made while the far proposal is stored
+   push_action( N(bob), N(invalidate), mvo()
+                  ("account",      "bob")
+   );
+   push_action( N(bob), N(cancel), mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "far")
+                  ("canceler",      "bob")
+   );
+
+   //the cancelled far proposal does not hold back the invalidations made after it is gone
+   push_action( N(alice), N(propose), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("trx",           trx)
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+   push_action( N(alice), N(invalidate), mvo()
+                  ("account",      "alice")
+   );
+   push_action( N(carol), N(invalidate), mvo()
+                  ("account",      "carol")
+   );
+
+   produce_block( fc::minutes(31) );
+
+   //bob's invalidation can not be removed yet, but still counts towards max
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 2) );
+   BOOST_REQUIRE( get_inval( N(alice) ).empty() );
+   BOOST_REQUIRE( !get_inval( N(bob) ).empty() );
+   BOOST_REQUIRE( !get_inval( N(carol) ).empty() );
+
+   //the next call continues after bob
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "bob1")("max", 1) );
+   BOOST_REQUIRE( !get_inval( N(bob) ).empty() );
+   BOOST_REQUIRE( get_inval( N(carol) ).empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( gc_invalidations_old_proposal, eosio_msig_tester ) try {
+   auto get_inval = [&]( account_name account ) {
+      return get_row_by_account( N(eosio.msig), N(eosio.msig), N(invals), account );
+   };
+
+   set_code( N(eosio.msig), contracts::util::msig_wasm_old() );
+   set_abi( N(eosio.msig), contracts::util::msig_abi_old().data() );
+   produce_blocks();
+
+   //propose and approve with old version of eosio.msig, the proposal outlives the ones made after the upgrade
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   auto old_trx = trx;
+   old_trx.expiration = control->head_block_time() + fc::hours(2);
+   push_action( N(alice), N(propose), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("trx",           old_trx)
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+   push_action( N(alice), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(alice), config::active_name })
+   );
+
+   set_code( N(eosio.msig), contracts::msig_wasm() );
+   set_abi( N(eosio.msig), contracts::msig_abi().data() );
+   produce_blocks();
+
+   push_action( N(bob), N(propose), mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "first")
+                  ("trx",           trx)
+                  ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+   );
+   push_action( N(alice), N(invalidate), mvo()
+                  ("account",      "alice")
+   );
+
+   //the invalidation is made before garbage collection is initialized, so it is kept after the new proposal expires
+   produce_block( fc::minutes(31) );
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 10) );
+   BOOST_REQUIRE( !get_inval( N(alice) ).empty() );
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(exec), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("executer",      "alice")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("transaction authorization failed")
+   );
+
+   push_action( N(eosio.msig), N(initgcinvals), mvo()("max_expiration", fc::time_point_sec(old_trx.expiration)) );
+   push_action( N(alice), N(invalidate), mvo()
+                  ("account",      "alice")
+   );
+
+   //the invalidation is kept while the old proposal may still be executed
+   produce_block( fc::minutes(60) );
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 10) );
+   BOOST_REQUIRE( !get_inval( N(alice) ).empty() );
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(exec), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "first")
+                                          ("executer",      "alice")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("transaction authorization failed")
+   );
+
+   produce_block( fc::minutes(31) );
+   push_action( N(carol), N(gcinvals), mvo()("lower_bound", "")("max", 10) );
+   BOOST_REQUIRE( get_inval( N(alice) ).empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( gc_expired_proposals, eosio_msig_tester ) try {
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   auto later_trx = trx;
+   later_trx.expiration = control->head_block_time() + fc::hours(2);
+
+   auto propose = [&]( account_name proposer, const transaction& t ) {
+      push_action( proposer, N(propose), mvo()
+                     ("proposer",      proposer)
+                     ("proposal_name", "first")
+                     ("trx",           t)
+                     ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+      );
+   };
+   auto has_proposal = [&]( account_name proposer ) {
+      return !get_row_by_account( N(eosio.msig), proposer, N(proposal), N(first) ).empty();
+   };
+   propose( N(alice), trx );
+   propose( N(bob), trx );
+   propose( N(carol), later_trx );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(carol), N(gcexpired), mvo()("max", 0) ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("max must be positive")
+   );
+
+   //nothing has expired yet
+   push_action( N(carol), N(gcexpired), mvo()("max", 10) );
+   BOOST_REQUIRE( has_proposal( N(alice) ) && has_proposal( N(bob) ) && has_proposal( N(carol) ) );
+
+   produce_block( fc::minutes(31) );
+
+   //earliest expiration first, at most max proposals
+   push_action( N(carol), N(gcexpired), mvo()("max", 1) );
+   BOOST_REQUIRE( !has_proposal( N(alice) ) );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(approvals2), N(first) ).empty() );
+   BOOST_REQUIRE( has_proposal( N(bob) ) && has_proposal( N(carol) ) );
+
+   push_action( N(carol), N(gcexpired), mvo()("max", 10) );
+   BOOST_REQUIRE( !has_proposal( N(bob) ) );
+   BOOST_REQUIRE( has_proposal( N(carol) ) );
+
+   //cancelled proposals are removed from the expiration index
+   push_action( N(carol), N(cancel), mvo()
+                  ("proposer",      "carol")
+                  ("proposal_name", "first")
+                  ("canceler",      "carol")
+   );
+   produce_block( fc::hours(2) );
+   push_action( N(carol), N(gcexpired), mvo()("max", 10) );
+   BOOST_REQUIRE( !has_proposal( N(carol) ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( migrate_old_approvals, eosio_msig_tester ) try {
+   set_code( N(eosio.msig), contracts::util::msig_wasm_old() );
+   set_abi( N(eosio.msig), contracts::util::msig_abi_old().data() );
+   produce_blocks();
+
+   //propose and approve by alice with old version of eosio.msig
+   auto trx = reqauth( N(alice), vector<permission_level>{ { N(alice), config::active_name }, { N(bob), config::active_name } }, abi_serializer_max_time );
+   for ( auto proposal_name : { N(first), N(second) } ) {
+      push_action( N(alice), N(propose), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", proposal_name)
+                     ("trx",           trx)
+                     ("requested", vector<permission_level>{ { N(bob), config::active_name }, { N(alice), config::active_name } })
+      );
+      push_action( N(alice), N(approve), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", proposal_name)
+                     ("level",         permission_level{ N(alice), config::active_name })
+      );
+   }
+
+   set_code( N(eosio.msig), contracts::msig_wasm() );
+   set_abi( N(eosio.msig), contracts::msig_abi().data() );
+   produce_blocks();
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(migrateapps), mvo()
+                                          ("proposers", vector<account_name>{ N(alice) })
+                                          ("max",       10)
+                            ),
+                            missing_auth_exception,
+                            fc_exception_message_starts_with("missing authority")
+   );
+
+   push_action( N(eosio.msig), N(migrateapps), mvo()
+                  ("proposers", vector<account_name>{ N(alice) })
+                  ("max",       1)
+   );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(approvals), N(first) ).empty() );
+   BOOST_REQUIRE( !get_row_by_account( N(eosio.msig), N(alice), N(approvals), N(second) ).empty() );
+
+   push_action( N(eosio.msig), N(migrateapps), mvo()
+                  ("proposers", vector<account_name>{ N(bob), N(alice) })
+                  ("max",       10)
+   );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(approvals), N(second) ).empty() );
+
+   auto apps = abi_ser.binary_to_variant( "approvals_info", get_row_by_account( N(eosio.msig), N(alice), N(approvals2), N(second) ), abi_serializer_max_time );
+   BOOST_REQUIRE_EQUAL( 2, apps["version"].as<uint8_t>() );
+   BOOST_REQUIRE_EQUAL( 1, apps["requested_approvals"].size() );
+   BOOST_REQUIRE_EQUAL( name(N(bob)), apps["requested_approvals"][size_t(0)]["level"]["actor"].as<account_name>() );
+   BOOST_REQUIRE_EQUAL( 1, apps["provided_approvals"].size() );
+   BOOST_REQUIRE_EQUAL( name(N(alice)), apps["provided_approvals"][size_t(0)]["level"]["actor"].as<account_name>() );
+
+   //approve and execute the migrated proposal with new version
+   push_action( N(bob), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("level",         permission_level{ N(bob), config::active_name })
+   );
+
+   transaction_trace_ptr trace;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->scheduled ) { trace = t; }
+   } );
+
+   push_action( N(alice), N(exec), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("executer",      "alice")
+   );
+
+   BOOST_REQUIRE( bool(trace) );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( transaction_receipt::executed, trace->receipt->status );
+
+   //a migrated approval is invalidated by any invalidation of its actor, as before the migration
+   push_action( N(bob), N(approve), mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("level",         permission_level{ N(bob), config::active_name })
+   );
+   push_action( N(alice), N(invalidate), mvo()
+                  ("account",      "alice")
+   );
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(exec), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "second")
+                                          ("executer",      "alice")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("transaction authorization failed")
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( propose_approve_execinline, eosio_msig_tester ) try {
+   auto trx = reqauth( N(alice), {permission_level{N(alice), config::active_name}}, abi_serializer_max_time );
+   auto delayed_trx = trx;
+   delayed_trx.delay_sec = 10;
+
+   for ( const auto& p : { std::make_pair( N(first), trx ), std::make_pair( N(second), delayed_trx ) } ) {
+      push_action( N(alice), N(propose), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", p.first)
+                     ("trx",           p.second)
+                     ("requested", vector<permission_level>{{ N(alice), config::active_name }})
+      );
+      push_action( N(alice), N(approve), mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", p.first)
+                     ("level",         permission_level{ N(alice), config::active_name })
+      );
+   }
+
+   BOOST_REQUIRE_EXCEPTION( push_action( N(alice), N(execinline), mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "second")
+                                          ("executer",      "alice")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("inline execution requires a transaction without delay")
+   );
+
+   bool scheduled = false;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      if( std::get<0>(p)->scheduled ) { scheduled = true; }
+   } );
+
+   //the proposed actions are executed within the execinline transaction
+   auto trace = push_action( N(alice), N(execinline), mvo()
+                                ("proposer",      "alice")
+                                ("proposal_name", "first")
+                                ("executer",      "alice")
+   );
+
+   BOOST_REQUIRE( !scheduled );
+   BOOST_REQUIRE_EQUAL( 2, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( N(reqauth), name{trace->action_traces[1].act.name} );
+   BOOST_REQUIRE( get_row_by_account( N(eosio.msig), N(alice), N(proposal), N(first) ).empty() );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -337,6 +337,26 @@ public:
       return unstake( account_name(acnt), net, cpu );
    }
 
+   static fc::variant bandwidth_delegation( const account_name& receiver, const asset& net, const asset& cpu ) {
+      return mvo()("receiver", receiver)("net_quantity", net)("cpu_quantity", cpu);
+   }
+
+   action_result delegatemany( const account_name& from, const vector<fc::variant>& delegations ) {
+      return push_action( name(from), N(delegatemany), mvo()("from", from)("delegations", delegations) );
+   }
+
+   action_result undelegmany( const account_name& from, const vector<fc::variant>& delegations ) {
+      return push_action( name(from), N(undelegmany), mvo()("from", from)("delegations", delegations) );
+   }
+
+   action_result procrefunds( const account_name& user, uint16_t max ) {
+      return push_action( name(user), N(procrefunds), mvo()("user", user)("max", max) );
+   }
+
+   action_result queuerefunds( const vector<account_name>& owners ) {
+      return push_action( config::system_account_name, N(queuerefunds), mvo()("owners", owners) );
+   }
+
    int64_t bancor_convert( int64_t S, int64_t R, int64_t T ) { return double(R) * T  / ( double(S) + T ); };
 
    int64_t get_net_limit( account_name a ) {
@@ -610,6 +630,11 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant("delegated_bandwidth", data, abi_serializer_max_time);
    }
 
+   fc::variant get_inbound_dbw_obj( const account_name& receiver, const account_name& from ) const {
+      vector<char> data = get_row_by_account( config::system_account_name, receiver, N(delbandin), from );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant("inbound_delegation", data, abi_serializer_max_time);
+   }
+
    asset get_rex_balance( const account_name& act ) const {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(rexbal), act );
       return data.empty() ? asset(0, symbol(SY(4, REX))) : abi_ser.binary_to_variant("rex_balance", data, abi_serializer_max_time)["rex_balance"].as<asset>();
@@ -743,6 +768,31 @@ public:
       return bidname( account_name(bidder), account_name(newname), bid );
    }
 
+   action_result claimbidref( const account_name& bidder ) {
+      return push_action( name(bidder), N(claimbidref), mvo()("bidder", bidder) );
+   }
+
+   action_result flushbidrefs( const account_name& user, uint16_t max ) {
+      return push_action( name(user), N(flushbidrefs), mvo()("user", user)("max", max) );
+   }
+
+   fc::variant get_bid_refund( const account_name& bidder ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(bidledger), bidder );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "bid_refund", data, abi_serializer_max_time );
+   }
+
+   action_result closebids( const account_name& user, uint16_t max ) {
+      return push_action( name(user), N(closebids), mvo()("user", user)("max", max) );
+   }
+
+   action_result migratevpay( const account_name& user, uint16_t max, const account_name& lower_bound = account_name() ) {
+      return push_action( name(user), N(migratevpay), mvo()("user", user)("lower_bound", lower_bound)("max", max) );
+   }
+
+   action_result settlerewards( const account_name& user, uint16_t max, const account_name& lower_bound = account_name() ) {
+      return push_action( name(user), N(settlerewards), mvo()("user", user)("lower_bound", lower_bound)("max", max) );
+   }
+
    static fc::variant_object producer_parameters_example( int n ) {
       return mutable_variant_object()
          ("max_block_net_usage", 10000000 + n )
@@ -832,6 +882,11 @@ public:
       return get_producer_info2( account_name(act) );
    }
 
+   uint32_t get_unpaid_block_count( const account_name& act ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(blockcounts), act );
+      return data.empty() ? 0 : abi_ser.binary_to_variant( "producer_block_count", data, abi_serializer_max_time )["unpaid_blocks"].as<uint32_t>();
+   }
+
    void create_currency( name contract, name manager, asset maxsupply ) {
       auto act =  mutable_variant_object()
          ("issuer",       manager )
@@ -947,11 +1002,21 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state3", data, abi_serializer_max_time );
    }
 
+   fc::variant get_global_state4() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(global4), N(global4) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state4", data, abi_serializer_max_time );
+   }
+
    fc::variant get_refund_request( name account ) {
       vector<char> data = get_row_by_account( config::system_account_name, account, N(refunds), account );
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "refund_request", data, abi_serializer_max_time );
    }
 
+   fc::variant get_refund_queue_entry( name account ) {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(refundqueue), account );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "refund_queue_entry", data, abi_serializer_max_time );
+   }
+
    abi_serializer initialize_multisig() {
       abi_serializer msig_abi_ser;
       {
@@ -5,6 +5,7 @@
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <cstdlib>
 #include <iostream>
+#include <numeric>
 #include <sstream>
 #include <fc/log/logger.hpp>
 #include <eosio/chain/exceptions.hpp>
@@ -201,9 +202,15 @@ BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    produce_blocks(1);
    BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
    BOOST_REQUIRE_EQUAL( init_eosio_stake_balance + core_sym::from_string("300.0000"), get_balance( N(eosio.stake) ) );
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(bob111111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( false, get_refund_request( N(alice1111111) ).is_null() );
    //after 3 days funds should be released
    produce_block( fc::hours(1) );
    produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(bob111111111), 10 ) );
+   BOOST_TEST_REQUIRE( get_refund_request( N(alice1111111) ).is_null() );
    BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
    BOOST_REQUIRE_EQUAL( init_eosio_stake_balance, get_balance( N(eosio.stake) ) );
 
@@ -233,6 +240,7 @@ BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    //after 3 days funds should be released
    produce_block( fc::hours(1) );
    produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(bob111111111), 10 ) );
 
    REQUIRE_MATCHING_OBJECT( voter( "alice1111111", core_sym::from_string("0.0000") ), get_voter_info( "alice1111111" ) );
    produce_blocks(1);
@@ -278,6 +286,7 @@ BOOST_FIXTURE_TEST_CASE( stake_unstake_with_transfer, eosio_system_tester ) try
 
    produce_block( fc::hours(1) );
    produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(bob111111111), 10 ) );
 
    BOOST_REQUIRE_EQUAL( core_sym::from_string("1300.0000"), get_balance( "alice1111111" ) );
 
@@ -342,6 +351,7 @@ BOOST_FIXTURE_TEST_CASE( stake_while_pending_refund, eosio_system_tester ) try {
 
    produce_block( fc::hours(1) );
    produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(bob111111111), 10 ) );
 
    BOOST_REQUIRE_EQUAL( core_sym::from_string("1300.0000"), get_balance( "alice1111111" ) );
 
@@ -733,6 +743,258 @@ BOOST_FIXTURE_TEST_CASE( stake_to_another_user_not_from_refund, eosio_system_tes
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( process_refunds, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+
+   //staking to another user does not take the pending refund out of the queue
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "carol1111111", core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("680.0000"), get_balance( "alice1111111" ) );
+
+   //refunds are not paid out automatically once matured
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("680.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "bob111111111" ) );
+
+   //only the oldest matured refund is processed
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(carol1111111), 1 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("980.0000"), get_balance( "alice1111111" ) );
+   BOOST_TEST_REQUIRE( get_refund_request( N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( false, get_refund_request( N(bob111111111) ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("850.0000"), get_balance( "bob111111111" ) );
+   BOOST_TEST_REQUIRE( get_refund_request( N(bob111111111) ).is_null() );
+
+   //refund claimed by its owner is removed from the queue
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(bob111111111), N(refund), mvo()("owner", "bob111111111") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "bob111111111" ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( process_refunds_rejecting_owner, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), buyram( "alice1111111", "alice1111111", core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+
+   // alice, whose refund is the oldest, rejects every notification
+   set_code( N(alice1111111), contracts::util::reject_all_wasm() );
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+
+   // until revision 5 the payout notifies alice, which aborts the whole batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rejecting all notifications"), procrefunds( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("700.0000"), get_balance( "bob111111111" ) );
+
+   for ( uint8_t revision = 1; revision <= 5; ++revision ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", revision) ) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("900.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "bob111111111" ) );
+   BOOST_TEST_REQUIRE( get_refund_request( N(alice1111111) ).is_null() );
+   BOOST_TEST_REQUIRE( get_refund_request( N(bob111111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( queue_pending_refunds, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+
+   // refund requested before the refund queue existed
+   set_code( config::system_account_name, contracts::util::system_wasm_v1_8() );
+   set_abi(  config::system_account_name, contracts::util::system_abi_v1_8().data() );
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", core_sym::from_string("200.0000"), core_sym::from_string("100.0000") ) );
+   set_code( config::system_account_name, contracts::system_wasm() );
+   set_abi(  config::system_account_name, contracts::system_abi().data() );
+   produce_block();
+
+   const auto request_time = get_refund_request( N(alice1111111) )["request_time"];
+   BOOST_TEST_REQUIRE( get_refund_queue_entry( N(alice1111111) ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( N(alice1111111), N(queuerefunds), mvo()("owners", vector<account_name>{ N(alice1111111) }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no owners specified"), queuerefunds( {} ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("refund request not found"), queuerefunds( { N(alice1111111), N(bob111111111) } ) );
+
+   BOOST_REQUIRE_EQUAL( success(), queuerefunds( { N(alice1111111) } ) );
+   BOOST_REQUIRE_EQUAL( request_time, get_refund_queue_entry( N(alice1111111) )["request_time"] );
+   // owners already queued are skipped
+   BOOST_REQUIRE_EQUAL( success(), queuerefunds( { N(alice1111111) } ) );
+
+   // the refund is paid out, and taken out of the queue, by whichever of the refund actions runs first
+   produce_block( fc::hours(3*24) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1000.0000"), get_balance( "alice1111111" ) );
+   BOOST_TEST_REQUIRE( get_refund_request( N(alice1111111) ).is_null() );
+   BOOST_TEST_REQUIRE( get_refund_queue_entry( N(alice1111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( delegate_undelegate_many, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( N(alice1111111) ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(alice1111111), { N(alice1111111) } ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no delegations specified"), delegatemany( N(alice1111111), {} ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("must stake a positive amount"),
+                        delegatemany( N(alice1111111), { bandwidth_delegation( N(bob111111111), core_sym::from_string("0.0000"), core_sym::from_string("0.0000") ) } ) );
+
+   const auto init_eosio_stake_balance = get_balance( N(eosio.stake) );
+   BOOST_REQUIRE_EQUAL( success(), delegatemany( N(alice1111111), {
+      bandwidth_delegation( N(bob111111111), core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ),
+      bandwidth_delegation( N(carol1111111), core_sym::from_string("5.0000"),  core_sym::from_string("5.0000") ),
+      bandwidth_delegation( N(bob111111111), core_sym::from_string("1.0000"),  core_sym::from_string("0.0000") ) } ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("809.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( init_eosio_stake_balance + core_sym::from_string("41.0000"), get_balance( N(eosio.stake) ) );
+
+   auto total = get_total_stake( "bob111111111" );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("31.0000"), total["net_weight"].as<asset>());
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), total["cpu_weight"].as<asset>());
+   total = get_total_stake( "carol1111111" );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("15.0000"), total["net_weight"].as<asset>());
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("15.0000"), total["cpu_weight"].as<asset>());
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("191.0000").get_amount(), get_voter_info( "alice1111111" )["staked"].as_int64() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("191.0000")) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+
+   //undelegating more than was delegated to one of the receivers fails the whole batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("insufficient staked cpu bandwidth"),
+                        undelegmany( N(alice1111111), {
+                           bandwidth_delegation( N(bob111111111), core_sym::from_string("21.0000"), core_sym::from_string("10.0000") ),
+                           bandwidth_delegation( N(carol1111111), core_sym::from_string("0.0000"),  core_sym::from_string("5.0001") ) } ) );
+
+   BOOST_REQUIRE_EQUAL( success(), undelegmany( N(alice1111111), {
+      bandwidth_delegation( N(bob111111111),  core_sym::from_string("21.0000"), core_sym::from_string("10.0000") ),
+      bandwidth_delegation( N(carol1111111),  core_sym::from_string("5.0000"),  core_sym::from_string("5.0000") ),
+      bandwidth_delegation( N(alice1111111),  core_sym::from_string("50.0000"), core_sym::from_string("0.0000") ) } ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("809.0000"), get_balance( "alice1111111" ) );
+   auto refund = get_refund_request( N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("76.0000"), refund["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("15.0000"), refund["cpu_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("100.0000").get_amount(), get_voter_info( "alice1111111" )["staked"].as_int64() );
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("100.0000")) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( get_total_stake( "carol1111111" )["net_weight"].as<asset>() == core_sym::from_string("10.0000") );
+
+   //stake delegated to self is taken from the pending refund first
+   BOOST_REQUIRE_EQUAL( success(), delegatemany( N(alice1111111), {
+      bandwidth_delegation( N(alice1111111), core_sym::from_string("80.0000"), core_sym::from_string("0.0000") ),
+      bandwidth_delegation( N(bob111111111), core_sym::from_string("10.0000"), core_sym::from_string("0.0000") ) } ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("795.0000"), get_balance( "alice1111111" ) );
+   refund = get_refund_request( N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"),  refund["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("15.0000"), refund["cpu_amount"].as<asset>() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( inbound_delegations, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "carol1111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", "carol1111111", core_sym::from_string("5.0000"),  core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake_with_transfer( N(bob111111111), N(carol1111111), core_sym::from_string("1.0000"), core_sym::from_string("1.0000") ) );
+
+   auto dbw = get_inbound_dbw_obj( N(carol1111111), N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( "alice1111111", dbw["from"].as_string() );
+   BOOST_REQUIRE_EQUAL( "carol1111111", dbw["to"].as_string() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), dbw["cpu_weight"].as<asset>() );
+   dbw = get_inbound_dbw_obj( N(carol1111111), N(bob111111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("5.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), dbw["cpu_weight"].as<asset>() );
+   //stake transferred to carol is delegated by carol to self
+   dbw = get_inbound_dbw_obj( N(carol1111111), N(carol1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"), dbw["cpu_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( true, get_inbound_dbw_obj( N(alice1111111), N(carol1111111) ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "carol1111111", core_sym::from_string("5.0000"), core_sym::from_string("10.0000") ) );
+   dbw = get_inbound_dbw_obj( N(carol1111111), N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("15.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"),  dbw["cpu_weight"].as<asset>() );
+
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "carol1111111", core_sym::from_string("15.0000"), core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( true,  get_inbound_dbw_obj( N(carol1111111), N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( false, get_inbound_dbw_obj( N(carol1111111), N(bob111111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( fill_inbound_delegations, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+
+   // delegations made before inbound delegations were tracked
+   set_code( config::system_account_name, contracts::util::system_wasm_v1_8() );
+   set_abi(  config::system_account_name, contracts::util::system_abi_v1_8().data() );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "carol1111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "alice1111111", "bob111111111", core_sym::from_string("3.0000"),  core_sym::from_string("2.0000") ) );
+   set_code( config::system_account_name, contracts::system_wasm() );
+   set_abi(  config::system_account_name, contracts::system_abi().data() );
+   produce_block();
+
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", "carol1111111", core_sym::from_string("5.0000"),  core_sym::from_string("0.0000") ) );
+   BOOST_REQUIRE_EQUAL( true,  get_inbound_dbw_obj( N(carol1111111), N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( true,  get_inbound_dbw_obj( N(bob111111111), N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( false, get_inbound_dbw_obj( N(carol1111111), N(bob111111111) ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( N(alice1111111), N(fillinbound), mvo()("delegators", vector<account_name>{ N(alice1111111) }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("no delegators specified"),
+                        push_action( config::system_account_name, N(fillinbound), mvo()("delegators", vector<account_name>{}) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(fillinbound),
+                                                mvo()("delegators", vector<account_name>{ N(alice1111111), N(bob111111111) }) ) );
+   auto dbw = get_inbound_dbw_obj( N(carol1111111), N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), dbw["cpu_weight"].as<asset>() );
+   dbw = get_inbound_dbw_obj( N(bob111111111), N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("3.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("2.0000"), dbw["cpu_weight"].as<asset>() );
+   dbw = get_inbound_dbw_obj( N(carol1111111), N(bob111111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("5.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), dbw["cpu_weight"].as<asset>() );
+
+   // filled in rows are maintained as any other
+   BOOST_REQUIRE_EQUAL( success(), unstake( "alice1111111", "carol1111111", core_sym::from_string("5.0000"), core_sym::from_string("10.0000") ) );
+   dbw = get_inbound_dbw_obj( N(carol1111111), N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("15.0000"), dbw["net_weight"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"),  dbw["cpu_weight"].as<asset>() );
+
+} FC_LOG_AND_RETHROW()
+
 // Tests for voting
 BOOST_FIXTURE_TEST_CASE( producer_register_unregister, eosio_system_tester ) try {
    issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
@@ -1075,10 +1337,44 @@ BOOST_FIXTURE_TEST_CASE( vote_for_producer, eosio_system_tester, * boost::unit_t
    //carol1111111 should receive funds in 3 days
    produce_block( fc::days(3) );
    produce_block();
+   BOOST_REQUIRE_EQUAL( success(), procrefunds( N(bob111111111), 10 ) );
    BOOST_REQUIRE_EQUAL( core_sym::from_string("3000.0000"), get_balance( "carol1111111" ) );
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( stake_change_applies_vote_weight_difference, eosio_system_tester, * boost::unit_test::tolerance(1e-10) ) try {
+   cross_15_percent_threshold();
+
+   issue_and_transfer( "bob111111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( N(alice1111111) ) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( N(carol1111111) ) );
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("100.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(bob111111111), { N(alice1111111) } ) );
+
+   const double alice_votes = get_producer_info( "alice1111111" )["total_votes"].as_double();
+   const double total_votes = get_global_state()["total_producer_vote_weight"].as_double();
+   const double old_weight  = get_voter_info( "bob111111111" )["last_vote_weight"].as_double();
+   BOOST_TEST_REQUIRE( stake2votes(core_sym::from_string("150.0000")) == old_weight );
+
+   // increasing the stake adds the weight difference to the voted producer only
+   BOOST_REQUIRE_EQUAL( success(), stake( "bob111111111", core_sym::from_string("20.0000"), core_sym::from_string("10.0000") ) );
+   double new_weight = stake2votes(core_sym::from_string("180.0000"));
+   BOOST_TEST_REQUIRE( new_weight == get_voter_info( "bob111111111" )["last_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( alice_votes + (new_weight - old_weight) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( total_votes + (new_weight - old_weight) == get_global_state()["total_producer_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( 0.0 == get_producer_info( "carol1111111" )["total_votes"].as_double() );
+   BOOST_REQUIRE_EQUAL( 1u, get_voter_info( "bob111111111" )["producers"].get_array().size() );
+
+   // decreasing it subtracts the difference
+   BOOST_REQUIRE_EQUAL( success(), unstake( "bob111111111", core_sym::from_string("60.0000"), core_sym::from_string("40.0000") ) );
+   new_weight = stake2votes(core_sym::from_string("80.0000"));
+   BOOST_TEST_REQUIRE( new_weight == get_voter_info( "bob111111111" )["last_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( alice_votes + (new_weight - old_weight) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( total_votes + (new_weight - old_weight) == get_global_state()["total_producer_vote_weight"].as_double() );
+   BOOST_TEST_REQUIRE( 0.0 == get_producer_info( "carol1111111" )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_FIXTURE_TEST_CASE( unregistered_producer_voting, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
    issue_and_transfer( "bob111111111", core_sym::from_string("2000.0000"),  config::system_account_name );
@@ -2577,6 +2873,134 @@ BOOST_FIXTURE_TEST_CASE(votepay_share_update_order, eosio_system_tester, * boost
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(votepay_checkpoint, eosio_system_tester, * boost::unit_test::tolerance(1e-10)) try {
+
+   const std::vector<account_name> producer_names = active_and_vote_producers();
+   for ( uint8_t revision = 1; revision <= 4; ++revision ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", revision) ) );
+   }
+
+   const auto prod_name = producer_names.front();
+   const auto producers2_row = [&]( const account_name& p ) {
+      return get_row_by_account( config::system_account_name, config::system_account_name, N(producers2), p );
+   };
+
+   // votes keep updating the producers2 row, voters never grow the producers row
+   BOOST_REQUIRE( !producers2_row( prod_name ).empty() );
+   BOOST_REQUIRE( !get_producer_info( prod_name ).get_object().contains("votepay_checkpoint") );
+   const auto     initial_info2       = get_producer_info2( prod_name );
+   const double   initial_total_votes = get_producer_info( prod_name )["total_votes"].as_double();
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), stake( N(alice1111111), N(alice1111111), core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   for ( const auto& p : producer_names ) {
+      BOOST_REQUIRE( !producers2_row( p ).empty() );
+      BOOST_REQUIRE( !get_producer_info( p ).get_object().contains("votepay_checkpoint") );
+   }
+   {
+      const auto     info2          = get_producer_info2( prod_name );
+      const uint64_t initial_update = microseconds_since_epoch_of_iso_string( initial_info2["last_votepay_share_update"] );
+      const uint64_t update         = microseconds_since_epoch_of_iso_string( info2["last_votepay_share_update"] );
+      BOOST_REQUIRE_EQUAL( update, microseconds_since_epoch_of_iso_string( get_global_state3()["last_vpay_state_update"] ) );
+      BOOST_TEST_REQUIRE( initial_info2["votepay_share"].as_double() + initial_total_votes * double( (update - initial_update) / 1E6 )
+                          == info2["votepay_share"].as_double() );
+   }
+
+   // claiming rewards pays vote pay, then moves the reset checkpoint into the producers row
+   produce_block( fc::hours(24) );
+   const int64_t pervote_bucket = get_global_state()["pervote_bucket"].as<int64_t>();
+   BOOST_REQUIRE_EQUAL( success(), push_action( prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
+   BOOST_REQUIRE( producers2_row( prod_name ).empty() );
+   auto checkpoint = get_producer_info( prod_name )["votepay_checkpoint"];
+   BOOST_TEST_REQUIRE( 0 == checkpoint["votepay_share"].as_double() );
+   BOOST_REQUIRE_EQUAL( get_producer_info( prod_name )["last_claim_time"].as_string(), checkpoint["last_votepay_share_update"].as_string() );
+   BOOST_REQUIRE( get_global_state()["pervote_bucket"].as<int64_t>() < pervote_bucket );
+   BOOST_REQUIRE( 0 < get_balance( prod_name ).get_amount() );
+
+   // later vote changes only update the checkpoint in the producers row
+   const double total_votes = get_producer_info( prod_name )["total_votes"].as_double();
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), stake( N(alice1111111), N(alice1111111), core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   BOOST_REQUIRE( producers2_row( prod_name ).empty() );
+   {
+      const auto     new_checkpoint = get_producer_info( prod_name )["votepay_checkpoint"];
+      const uint64_t last_update    = microseconds_since_epoch_of_iso_string( checkpoint["last_votepay_share_update"] );
+      const uint64_t update         = microseconds_since_epoch_of_iso_string( new_checkpoint["last_votepay_share_update"] );
+      BOOST_TEST_REQUIRE( checkpoint["votepay_share"].as_double() + total_votes * double( (update - last_update) / 1E6 )
+                          == new_checkpoint["votepay_share"].as_double() );
+      checkpoint = new_checkpoint;
+   }
+
+   double total_votes_of_producers = 0;
+   for ( const auto& p : producer_names ) {
+      total_votes_of_producers += get_producer_info( p )["total_votes"].as_double();
+   }
+   BOOST_TEST_REQUIRE( total_votes_of_producers == get_global_state3()["total_vpay_share_change_rate"].as_double() );
+
+   // deactivating the producer moves the checkpoint back into producers2 and leaves no authority in the row
+   BOOST_REQUIRE_EQUAL( success(), push_action( prod_name, N(unregprod), mvo()("producer", prod_name) ) );
+   BOOST_REQUIRE( !get_producer_info( prod_name ).get_object().contains("producer_authority") );
+   BOOST_REQUIRE( !get_producer_info( prod_name ).get_object().contains("votepay_checkpoint") );
+   BOOST_REQUIRE_EQUAL( checkpoint["votepay_share"].as_double(), get_producer_info2( prod_name )["votepay_share"].as_double() );
+   BOOST_REQUIRE_EQUAL( checkpoint["last_votepay_share_update"].as_string(),
+                        get_producer_info2( prod_name )["last_votepay_share_update"].as_string() );
+
+   // registering again moves it into the producers row
+   regproducer( prod_name );
+   BOOST_REQUIRE( producers2_row( prod_name ).empty() );
+   BOOST_REQUIRE_EQUAL( checkpoint["last_votepay_share_update"].as_string(),
+                        get_producer_info( prod_name )["votepay_checkpoint"]["last_votepay_share_update"].as_string() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(migrate_votepay_checkpoints, eosio_system_tester, * boost::unit_test::tolerance(1e-10)) try {
+
+   std::vector<account_name> producer_names = active_and_vote_producers();
+   std::sort( producer_names.begin(), producer_names.end() );
+   const auto producers2_row = [&]( const account_name& p ) {
+      return get_row_by_account( config::system_account_name, config::system_account_name, N(producers2), p );
+   };
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("votepay checkpoints can only be migrated from revision 4"),
+                        migratevpay( N(bob111111111), 10 ) );
+   for ( uint8_t revision = 1; revision <= 4; ++revision ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", revision) ) );
+   }
+
+   // an unregistered producer keeps its producers2 row and still counts toward max
+   const auto unregistered = producer_names.front();
+   BOOST_REQUIRE_EQUAL( success(), push_action( unregistered, N(unregprod), mvo()("producer", unregistered) ) );
+   const auto info2 = get_producer_info2( producer_names[1] );
+   BOOST_REQUIRE_EQUAL( success(), migratevpay( N(bob111111111), 3 ) );
+   BOOST_REQUIRE( !producers2_row( unregistered ).empty() );
+   BOOST_REQUIRE( !get_producer_info( unregistered ).get_object().contains("votepay_checkpoint") );
+   for ( size_t i = 1; i < 3; ++i ) {
+      BOOST_REQUIRE( producers2_row( producer_names[i] ).empty() );
+      BOOST_REQUIRE( get_producer_info( producer_names[i] ).get_object().contains("votepay_checkpoint") );
+   }
+   BOOST_REQUIRE( !producers2_row( producer_names[3] ).empty() );
+   {
+      const auto checkpoint = get_producer_info( producer_names[1] )["votepay_checkpoint"];
+      BOOST_REQUIRE_EQUAL( info2["votepay_share"].as_double(), checkpoint["votepay_share"].as_double() );
+      BOOST_REQUIRE_EQUAL( info2["last_votepay_share_update"].as_string(), checkpoint["last_votepay_share_update"].as_string() );
+   }
+
+   // a batch starting from lower_bound migrates the rest
+   BOOST_REQUIRE_EQUAL( success(), migratevpay( N(bob111111111), 100, producer_names[3] ) );
+   for ( size_t i = 1; i < producer_names.size(); ++i ) {
+      BOOST_REQUIRE( producers2_row( producer_names[i] ).empty() );
+   }
+
+   // votes no longer write producers2
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), stake( N(alice1111111), N(alice1111111), core_sym::from_string("10.0000"), core_sym::from_string("10.0000") ) );
+   for ( size_t i = 1; i < producer_names.size(); ++i ) {
+      BOOST_REQUIRE( producers2_row( producer_names[i] ).empty() );
+   }
+   BOOST_REQUIRE( info2["votepay_share"].as_double() <
+                  get_producer_info( producer_names[1] )["votepay_checkpoint"]["votepay_share"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE(votepay_transition, eosio_system_tester, * boost::unit_test::tolerance(1e-10)) try {
 
    const asset net = core_sym::from_string("80.0000");
@@ -2927,6 +3351,375 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(producer_onblock_block_counter, eosio_system_tester) try {
+
+   const std::vector<account_name> active_producers = active_and_vote_producers();
+
+   const auto total_unpaid_blocks = [&]() {
+      uint64_t total = get_global_state()["total_unpaid_blocks"].as<uint32_t>();
+      for ( const auto& p : active_producers ) {
+         total += get_unpaid_block_count( p );
+      }
+      return total;
+   };
+
+   // before revision 2 onblock does not use the block counter table
+   produce_blocks( 10 );
+   for ( const auto& p : active_producers ) {
+      BOOST_REQUIRE_EQUAL( 0, get_unpaid_block_count( p ) );
+   }
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 1) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 2) ) );
+   produce_block();
+
+   const auto raw_global_state = [&]( name table ) {
+      return get_row_by_account( config::system_account_name, config::system_account_name, table, table );
+   };
+
+   const uint64_t initial_total_unpaid_blocks = total_unpaid_blocks();
+   auto prev_global_state  = get_global_state();
+   auto prev_raw_global    = raw_global_state( N(global) );
+   auto prev_raw_global2   = raw_global_state( N(global2) );
+   uint32_t schedule_updates = 0;
+   for ( uint32_t i = 1; i <= 3 * 120; ++i ) {
+      produce_block();
+      const auto global_state = get_global_state();
+      if ( global_state["last_producer_schedule_update"].as_string() == prev_global_state["last_producer_schedule_update"].as_string() ) {
+         // only the block counter table is written between producer schedule updates
+         BOOST_REQUIRE( prev_raw_global  == raw_global_state( N(global) ) );
+         BOOST_REQUIRE( prev_raw_global2 == raw_global_state( N(global2) ) );
+         BOOST_REQUIRE( 0 < get_unpaid_block_count( control->pending_block_producer() ) );
+      } else {
+         ++schedule_updates;
+         BOOST_REQUIRE( prev_global_state["total_unpaid_blocks"].as<uint32_t>() < global_state["total_unpaid_blocks"].as<uint32_t>() );
+      }
+      BOOST_REQUIRE_EQUAL( initial_total_unpaid_blocks + i, total_unpaid_blocks() );
+      prev_global_state = global_state;
+      prev_raw_global   = raw_global_state( N(global) );
+      prev_raw_global2  = raw_global_state( N(global2) );
+   }
+   BOOST_REQUIRE( 2 <= schedule_updates );
+
+   // claiming rewards folds all pending block counts into the producers table
+   {
+      const auto prod_name = active_producers.front();
+      produce_block( fc::hours(24) );
+      const uint32_t unpaid_blocks = get_producer_info( prod_name )["unpaid_blocks"].as<uint32_t>() + get_unpaid_block_count( prod_name );
+      BOOST_REQUIRE( 0 < unpaid_blocks );
+      BOOST_REQUIRE_EQUAL( success(), push_action( prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
+      BOOST_REQUIRE( 0 < get_balance( prod_name ).get_amount() );
+      BOOST_REQUIRE_EQUAL( 0, get_producer_info( prod_name )["unpaid_blocks"].as<uint32_t>() );
+      for ( const auto& p : active_producers ) {
+         BOOST_REQUIRE_EQUAL( 0, get_unpaid_block_count( p ) );
+      }
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(producer_onblock_benchmark, eosio_system_tester) try {
+
+   const std::vector<account_name> active_producers = active_and_vote_producers();
+
+   // register enough additional producers to have 500 in the producers table
+   {
+      std::vector<account_name> producer_names;
+      const std::string root("benchprod");
+      for ( uint32_t i = 0; producer_names.size() + active_producers.size() < 500; ++i ) {
+         producer_names.emplace_back( root + std::string(1, 'a' + i / (26 * 26)) + std::string(1, 'a' + (i / 26) % 26) + std::string(1, 'a' + i % 26) );
+      }
+      for ( size_t i = 0; i < producer_names.size(); i += 50 ) {
+         const auto last = std::min( producer_names.size(), i + 50 );
+         setup_producer_accounts( std::vector<account_name>( producer_names.begin() + i, producer_names.begin() + last ) );
+         for ( auto p = producer_names.begin() + i; p != producer_names.begin() + last; ++p ) {
+            BOOST_REQUIRE_EQUAL( success(), regproducer( *p ) );
+         }
+         produce_block();
+      }
+   }
+
+   std::vector<int64_t> onblock_elapsed_us;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( t->action_traces.size() == 1 && t->action_traces[0].act.name == N(onblock) ) {
+         onblock_elapsed_us.push_back( t->elapsed.count() );
+      }
+   } );
+
+   // average onblock cost over the same number of blocks, covering three producer schedule updates
+   const auto average_onblock_us = [&]() {
+      onblock_elapsed_us.clear();
+      produce_blocks( 3 * 120 );
+      BOOST_REQUIRE( !onblock_elapsed_us.empty() );
+      return std::accumulate( onblock_elapsed_us.begin(), onblock_elapsed_us.end(), int64_t(0) ) / int64_t(onblock_elapsed_us.size());
+   };
+
+   // before revision 2 onblock modifies the producer row and the global state on every block
+   const int64_t baseline_us = average_onblock_us();
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 1) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 2) ) );
+   produce_block();
+
+   // from revision 2 only the block counter table is written between producer schedule updates
+   const int64_t counter_us = average_onblock_us();
+
+   ilog( "onblock with ${n} registered producers over ${c} blocks: ${b} us average before revision 2, ${r} us average from revision 2",
+         ("n", 500)("c", 3 * 120)("b", baseline_us)("r", counter_us) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(settle_producer_rewards, eosio_system_tester) try {
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("cannot settle rewards until the chain is activated (at least 15% of all tokens participate in voting)"),
+                        settlerewards( N(bob111111111), 21 ) );
+
+   const std::vector<account_name> producer_names = active_and_vote_producers();
+   produce_blocks( 21 * 12 );
+   produce_block( fc::hours(24) );
+
+   std::vector<account_name> unpaid_producers;
+   for ( const auto& p : producer_names ) {
+      if ( 0 < get_producer_info( p )["unpaid_blocks"].as<uint32_t>() ) {
+         unpaid_producers.push_back( p );
+      }
+   }
+   BOOST_REQUIRE( 2 < unpaid_producers.size() );
+
+   uint32_t issue_count = 0;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      for ( const auto& at : t->action_traces ) {
+         if ( at.receiver == N(eosio.token) && at.act.name == N(issue) ) {
+            ++issue_count;
+         }
+      }
+   } );
+
+   // settle two producers first
+   const auto supply = get_token_supply();
+   BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 2 ) );
+   BOOST_REQUIRE_EQUAL( 1, issue_count );
+   BOOST_REQUIRE( supply < get_token_supply() );
+   uint32_t settled = 0;
+   for ( const auto& p : unpaid_producers ) {
+      if ( 0 == get_producer_info( p )["unpaid_blocks"].as<uint32_t>() ) {
+         BOOST_REQUIRE( 0 < get_balance( p ).get_amount() );
+         BOOST_REQUIRE_EQUAL( wasm_assert_msg("already claimed rewards within past day"),
+                              push_action( p, N(claimrewards), mvo()("owner", p) ) );
+         ++settled;
+      }
+   }
+   BOOST_REQUIRE_EQUAL( 2, settled );
+
+   // producers that are not paid still count toward max, so the same two are visited again and nobody is paid
+   account_name next_producer;
+   {
+      produce_block();
+      std::map<account_name, asset> balances;
+      for ( const auto& p : unpaid_producers ) {
+         balances[p] = get_balance( p );
+         if ( next_producer == account_name() && 0 < get_producer_info( p )["unpaid_blocks"].as<uint32_t>() ) {
+            next_producer = p;
+         }
+      }
+      BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 2 ) );
+      for ( const auto& p : unpaid_producers ) {
+         BOOST_REQUIRE_EQUAL( balances[p], get_balance( p ) );
+      }
+   }
+
+   // a batch starting from lower_bound reaches producers below the ones already visited
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("producer not found"), settlerewards( N(bob111111111), 1, N(carol1111111) ) );
+   BOOST_REQUIRE( next_producer != account_name() );
+   BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 1, next_producer ) );
+   BOOST_REQUIRE_EQUAL( 0, get_producer_info( next_producer )["unpaid_blocks"].as<uint32_t>() );
+   BOOST_REQUIRE( 0 < get_balance( next_producer ).get_amount() );
+
+   // the rest are settled in one pass with a single issue
+   produce_block();
+   issue_count = 0;
+   BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 100 ) );
+   BOOST_REQUIRE( issue_count <= 1 );
+   for ( const auto& p : unpaid_producers ) {
+      BOOST_REQUIRE( 0 < get_balance( p ).get_amount() );
+      BOOST_REQUIRE_EQUAL( wasm_assert_msg("already claimed rewards within past day"),
+                           push_action( p, N(claimrewards), mvo()("owner", p) ) );
+   }
+
+   const auto gstate = get_global_state();
+   BOOST_REQUIRE_EQUAL( gstate["perblock_bucket"].as<int64_t>(), get_balance( N(eosio.bpay) ).get_amount() );
+   BOOST_REQUIRE_EQUAL( gstate["pervote_bucket"].as<int64_t>(), get_balance( N(eosio.vpay) ).get_amount() );
+
+   // nothing is left to settle within the same day
+   produce_block();
+   const auto balance = get_balance( unpaid_producers.front() );
+   BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 100 ) );
+   BOOST_REQUIRE_EQUAL( balance, get_balance( unpaid_producers.front() ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(settle_producer_rewards_rejecting_producer, eosio_system_tester) try {
+
+   const std::vector<account_name> producer_names = active_and_vote_producers();
+   produce_blocks( 21 * 12 );
+   produce_block( fc::hours(24) );
+
+   // a producer with unpaid blocks rejects every notification
+   account_name rejecting_producer;
+   for ( const auto& p : producer_names ) {
+      if ( 0 < get_producer_info( p )["unpaid_blocks"].as<uint32_t>() ) {
+         rejecting_producer = p;
+         break;
+      }
+   }
+   BOOST_REQUIRE( rejecting_producer != account_name() );
+   issue_and_transfer( "alice1111111", core_sym::from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), buyram( N(alice1111111), rejecting_producer, core_sym::from_string("100.0000") ) );
+   set_code( rejecting_producer, contracts::util::reject_all_wasm() );
+   produce_block();
+
+   // until revision 5 the payout notifies the producer, which aborts the whole batch
+   const auto balance = get_balance( rejecting_producer );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rejecting all notifications"), settlerewards( N(bob111111111), 100 ) );
+   BOOST_REQUIRE_EQUAL( balance, get_balance( rejecting_producer ) );
+
+   for ( uint8_t revision = 1; revision <= 5; ++revision ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", revision) ) );
+   }
+   produce_block( fc::hours(1) );
+   produce_blocks( 2 );
+
+   BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 100 ) );
+   BOOST_REQUIRE( balance < get_balance( rejecting_producer ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("already claimed rewards within past day"),
+                        push_action( rejecting_producer, N(claimrewards), mvo()("owner", rejecting_producer) ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(inflation_accrual_cadence, eosio_system_tester) try {
+
+   const uint64_t usecs_per_year = 52 * 7 * 24 * 3600 * 1000000ll;
+
+   const std::vector<account_name> producer_names = active_and_vote_producers();
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 1) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 2) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", 3) ) );
+
+   // onblock never sends inline actions, so a failing issue or transfer can not abort it
+   bool onblock_sent_inline = false;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( !t->action_traces.empty() && t->action_traces[0].act.name == N(onblock) && t->action_traces.size() > 1 ) {
+         onblock_sent_inline = true;
+      }
+   } );
+
+   const asset    initial_supply    = get_token_supply();
+   const uint64_t initial_fill_time = microseconds_since_epoch_of_iso_string( get_global_state()["last_pervote_bucket_fill"] );
+   const int64_t  initial_perblock  = get_global_state()["perblock_bucket"].as<int64_t>();
+   const int64_t  initial_pervote   = get_global_state()["pervote_bucket"].as<int64_t>();
+
+   // nothing is accrued before an hour has passed since the last fill
+   produce_block( fc::minutes(30) );
+   produce_blocks( 2 );
+   BOOST_REQUIRE_EQUAL( initial_supply, get_token_supply() );
+   BOOST_REQUIRE_EQUAL( initial_fill_time, microseconds_since_epoch_of_iso_string( get_global_state()["last_pervote_bucket_fill"] ) );
+
+   // onblock accrues inflation with fixed-point integer math into counters, without issuing it
+   produce_block( fc::minutes(31) );
+   produce_blocks( 2 );
+   const auto     global_state = get_global_state();
+   const uint64_t fill_time    = microseconds_since_epoch_of_iso_string( global_state["last_pervote_bucket_fill"] );
+   BOOST_REQUIRE( initial_fill_time + 3600 * 1000000ll <= fill_time );
+   BOOST_REQUIRE_EQUAL( initial_supply, get_token_supply() );
+   BOOST_REQUIRE( !onblock_sent_inline );
+
+   const auto    unissued = get_global_state4()["unissued"];
+   const int64_t to_savings       = unissued["to_savings"].as<int64_t>();
+   const int64_t to_per_block_pay = unissued["to_per_block_pay"].as<int64_t>();
+   const int64_t to_per_vote_pay  = unissued["to_per_vote_pay"].as<int64_t>();
+   const int64_t new_tokens       = to_savings + to_per_block_pay + to_per_vote_pay;
+   {
+      const uint64_t scaled_rate     = uint64_t( std::log1p(double(0.05)) * 1'000'000'000 );
+      const unsigned __int128 per_year = ( unsigned __int128(initial_supply.get_amount()) * scaled_rate ) / 1'000'000'000;
+      BOOST_REQUIRE( 0 < new_tokens );
+      BOOST_REQUIRE_EQUAL( int64_t( ( per_year * (fill_time - initial_fill_time) ) / usecs_per_year ), new_tokens );
+   }
+   BOOST_REQUIRE_EQUAL( initial_perblock + to_per_block_pay, global_state["perblock_bucket"].as<int64_t>() );
+   BOOST_REQUIRE_EQUAL( initial_pervote + to_per_vote_pay, global_state["pervote_bucket"].as<int64_t>() );
+
+   // a claim issues what has accrued once, then pays the producer
+   const asset saving_balance = get_balance( N(eosio.saving) );
+   const auto  prod_name = producer_names.front();
+   BOOST_REQUIRE( 0 < get_producer_info( prod_name )["unpaid_blocks"].as<uint32_t>() + get_unpaid_block_count( prod_name ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
+   BOOST_REQUIRE_EQUAL( initial_supply.get_amount() + new_tokens, get_token_supply().get_amount() );
+   BOOST_REQUIRE_EQUAL( saving_balance.get_amount() + to_savings, get_balance( N(eosio.saving) ).get_amount() );
+   BOOST_REQUIRE_EQUAL( 0, get_global_state4()["unissued"]["to_per_block_pay"].as<int64_t>() );
+   BOOST_REQUIRE( 0 < get_balance( prod_name ).get_amount() );
+   BOOST_REQUIRE_EQUAL( fill_time, microseconds_since_epoch_of_iso_string( get_global_state()["last_pervote_bucket_fill"] ) );
+   BOOST_REQUIRE_EQUAL( get_global_state()["perblock_bucket"].as<int64_t>(), get_balance( N(eosio.bpay) ).get_amount() );
+   BOOST_REQUIRE_EQUAL( get_global_state()["pervote_bucket"].as<int64_t>(), get_balance( N(eosio.vpay) ).get_amount() );
+
+   // nothing is issued again until more has accrued
+   const asset supply = get_token_supply();
+   BOOST_REQUIRE_EQUAL( success(), push_action( producer_names.back(), N(claimrewards), mvo()("owner", producer_names.back()) ) );
+   BOOST_REQUIRE_EQUAL( supply, get_token_supply() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(system_transfer_notifications, eosio_system_tester) try {
+
+   active_and_vote_producers();
+   for ( uint8_t revision = 1; revision <= 5; ++revision ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", revision) ) );
+   }
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("specified revision is not yet supported by the code"),
+                        push_action( config::system_account_name, N(updtrevision), mvo()("revision", 6) ) );
+   produce_block();
+
+   std::vector<action_trace> token_traces;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      if( !t->action_traces.empty() && t->action_traces[0].act.name == N(settlerewards) ) {
+         for ( const auto& at : t->action_traces ) {
+            if ( at.act.account == N(eosio.token) ) {
+               token_traces.push_back( at );
+            }
+         }
+      }
+   } );
+
+   // the inflation accrued by onblock is issued on settlement and moved to the reward buckets and savings
+   // without notifying them
+   const asset saving_balance = get_balance( N(eosio.saving) );
+   produce_block( fc::minutes(61) );
+   produce_blocks( 2 );
+   BOOST_REQUIRE_EQUAL( success(), settlerewards( N(bob111111111), 100 ) );
+
+   BOOST_REQUIRE_EQUAL( 1, std::count_if( token_traces.begin(), token_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(eosio.token) && t.act.name == N(issue);
+   }) );
+   BOOST_REQUIRE_EQUAL( 3, std::count_if( token_traces.begin(), token_traces.end(), []( const action_trace& t ) {
+      return t.act.name == N(systransfer);
+   }) );
+   for ( const auto& t : token_traces ) {
+      BOOST_REQUIRE( t.act.name != N(transfer) );
+      BOOST_REQUIRE( t.receiver != N(eosio.saving) && t.receiver != N(eosio.bpay) && t.receiver != N(eosio.vpay) );
+   }
+
+   const auto global_state = get_global_state();
+   BOOST_REQUIRE( saving_balance < get_balance( N(eosio.saving) ) );
+   BOOST_REQUIRE_EQUAL( global_state["perblock_bucket"].as<int64_t>(), get_balance( N(eosio.bpay) ).get_amount() );
+   BOOST_REQUIRE_EQUAL( global_state["pervote_bucket"].as<int64_t>(), get_balance( N(eosio.vpay) ).get_amount() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( voters_actions_affect_proxy_and_producers, eosio_system_tester, * boost::unit_test::tolerance(1e+6) ) try {
    cross_15_percent_threshold();
 
@@ -3315,6 +4108,9 @@ BOOST_FIXTURE_TEST_CASE( multiple_namebids, eosio_system_tester ) try {
       const asset initial_names_balance = get_balance(N(eosio.names));
       BOOST_REQUIRE_EQUAL( success(),
                            bidname( "alice", "prefb", core_sym::from_string("1.1001") ) );
+      // bob's bid is refunded once claimed from the bid refund ledger
+      BOOST_REQUIRE_EQUAL( core_sym::from_string( "9996.9997" ), get_balance("bob") );
+      BOOST_REQUIRE_EQUAL( success(), claimbidref( N(bob) ) );
       BOOST_REQUIRE_EQUAL( core_sym::from_string( "9997.9997" ), get_balance("bob") );
       BOOST_REQUIRE_EQUAL( core_sym::from_string( "9998.8999" ), get_balance("alice") );
       BOOST_REQUIRE_EQUAL( initial_names_balance + core_sym::from_string("0.1001"), get_balance(N(eosio.names)) );
@@ -3326,6 +4122,7 @@ BOOST_FIXTURE_TEST_CASE( multiple_namebids, eosio_system_tester ) try {
       BOOST_REQUIRE_EQUAL( core_sym::from_string( "10000.0000" ), get_balance("david") );
       BOOST_REQUIRE_EQUAL( success(),
                            bidname( "david", "prefd", core_sym::from_string("1.9900") ) );
+      BOOST_REQUIRE_EQUAL( success(), claimbidref( N(carl) ) );
       BOOST_REQUIRE_EQUAL( core_sym::from_string( "9999.0000" ), get_balance("carl") );
       BOOST_REQUIRE_EQUAL( core_sym::from_string( "9998.0100" ), get_balance("david") );
    }
@@ -3425,6 +4222,127 @@ BOOST_FIXTURE_TEST_CASE( namebid_pending_winner, eosio_system_tester ) try {
    create_account_with_resources( N(prefb), N(bob111111111) );
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( close_name_bids, eosio_system_tester ) try {
+   const std::string not_closed_message("auction for name is not closed yet");
+
+   cross_15_percent_threshold();
+   transfer( config::system_account_name, N(alice1111111), core_sym::from_string("10000.0000") );
+   transfer( config::system_account_name, N(bob111111111), core_sym::from_string("10000.0000") );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "50.0000" ) ));
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("name auctions cannot be closed until 14 days after the chain is activated"),
+                        closebids( N(carol1111111), 10 ) );
+
+   produce_block( fc::hours(14*24) );    //wait 14 day for name auction activation
+   produce_blocks(2);                    //onblock closes "prefa", the highest bid
+   create_account_with_resources( N(prefa), N(alice1111111) );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefb", core_sym::from_string( "30.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefc", core_sym::from_string( "20.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefd", core_sym::from_string( "40.0000" ) ));
+   produce_block( fc::hours(23) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefe", core_sym::from_string( "10.0000" ) ));
+   produce_block( fc::hours(2) );
+
+   //all auctions with no bids in the past 24 hours are closed, "prefe" is still open
+   BOOST_REQUIRE_EQUAL( success(), closebids( N(carol1111111), 10 ) );
+   create_account_with_resources( N(prefb), N(bob111111111) );
+   create_account_with_resources( N(prefc), N(alice1111111) );
+   create_account_with_resources( N(prefd), N(bob111111111) );
+   BOOST_REQUIRE_EXCEPTION( create_account_with_resources( N(prefe), N(alice1111111) ),
+                            fc::exception, fc_assert_exception_message_is( not_closed_message ) );
+
+   //at most max auctions are closed
+   produce_block( fc::hours(1) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "preff", core_sym::from_string( "12.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefg", core_sym::from_string( "15.0000" ) ));
+   produce_block( fc::hours(25) );
+   produce_blocks(2);                    //onblock closes "prefg", the highest bid
+   BOOST_REQUIRE_EQUAL( success(), closebids( N(carol1111111), 1 ) );
+   create_account_with_resources( N(prefg), N(bob111111111) );
+   create_account_with_resources( N(preff), N(bob111111111) );
+   BOOST_REQUIRE_EXCEPTION( create_account_with_resources( N(prefe), N(alice1111111) ),
+                            fc::exception, fc_assert_exception_message_is( not_closed_message ) );
+   BOOST_REQUIRE_EQUAL( success(), closebids( N(carol1111111), 1 ) );
+   create_account_with_resources( N(prefe), N(alice1111111) );
+
+   //auctions with a recent bid are skipped without counting toward max
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefh", core_sym::from_string( "5.0000" ) ));
+   produce_block( fc::hours(23) );
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefi", core_sym::from_string( "100.0000" ) ));
+   produce_block( fc::hours(2) );
+   produce_blocks(2);                    //onblock does not close "prefi", the highest bid
+   BOOST_REQUIRE_EQUAL( success(), closebids( N(carol1111111), 1 ) );
+   create_account_with_resources( N(prefh), N(bob111111111) );
+   BOOST_REQUIRE_EXCEPTION( create_account_with_resources( N(prefi), N(alice1111111) ),
+                            fc::exception, fc_assert_exception_message_is( not_closed_message ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( namebid_refund_ledger, eosio_system_tester ) try {
+   transfer( config::system_account_name, N(alice1111111), core_sym::from_string("10000.0000") );
+   transfer( config::system_account_name, N(bob111111111), core_sym::from_string("10000.0000") );
+   transfer( config::system_account_name, N(carol1111111), core_sym::from_string("10000.0000") );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "10.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefb", core_sym::from_string( "20.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "carol1111111", "prefc", core_sym::from_string( "5.0000" ) ));
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("refund not found"), claimbidref( N(alice1111111) ) );
+
+   //refunds owed to alice on both names accumulate in a single ledger row
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefa", core_sym::from_string( "12.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefb", core_sym::from_string( "25.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefc", core_sym::from_string( "6.0000" ) ));
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), get_bid_refund( N(alice1111111) )["amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("5.0000"),  get_bid_refund( N(carol1111111) )["amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9964.0000"), get_balance( "alice1111111" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), claimbidref( N(alice1111111) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9994.0000"), get_balance( "alice1111111" ) );
+   BOOST_TEST_REQUIRE( get_bid_refund( N(alice1111111) ).is_null() );
+
+   //refunds can be paid out in batches by any account
+   BOOST_REQUIRE_EQUAL( success(), bidname( "carol1111111", "prefa", core_sym::from_string( "14.0000" ) ));
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9963.0000"), get_balance( "bob111111111" ) );
+   BOOST_REQUIRE_EQUAL( success(), flushbidrefs( N(alice1111111), 1 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9975.0000"), get_balance( "bob111111111" ) );
+   BOOST_TEST_REQUIRE( get_bid_refund( N(bob111111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( false, get_bid_refund( N(carol1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), flushbidrefs( N(alice1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9986.0000"), get_balance( "carol1111111" ) );
+   BOOST_TEST_REQUIRE( get_bid_refund( N(carol1111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( namebid_refund_ledger_rejecting_bidder, eosio_system_tester ) try {
+   transfer( config::system_account_name, N(alice1111111), core_sym::from_string("10000.0000") );
+   transfer( config::system_account_name, N(bob111111111), core_sym::from_string("10000.0000") );
+   transfer( config::system_account_name, N(carol1111111), core_sym::from_string("10000.0000") );
+   BOOST_REQUIRE_EQUAL( success(), buyram( "alice1111111", "alice1111111", core_sym::from_string("100.0000") ) );
+
+   BOOST_REQUIRE_EQUAL( success(), bidname( "alice1111111", "prefa", core_sym::from_string( "10.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefa", core_sym::from_string( "12.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "bob111111111", "prefb", core_sym::from_string( "20.0000" ) ));
+   BOOST_REQUIRE_EQUAL( success(), bidname( "carol1111111", "prefb", core_sym::from_string( "25.0000" ) ));
+
+   //alice, first in the ledger, rejects every notification
+   set_code( N(alice1111111), contracts::util::reject_all_wasm() );
+
+   //until revision 5 the payout notifies alice, which aborts the whole batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg("rejecting all notifications"), flushbidrefs( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9968.0000"), get_balance( "bob111111111" ) );
+
+   for ( uint8_t revision = 1; revision <= 5; ++revision ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(updtrevision), mvo()("revision", revision) ) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), flushbidrefs( N(carol1111111), 10 ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9900.0000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("9988.0000"), get_balance( "bob111111111" ) );
+   BOOST_TEST_REQUIRE( get_bid_refund( N(alice1111111) ).is_null() );
+   BOOST_TEST_REQUIRE( get_bid_refund( N(bob111111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
 
    const asset net = core_sym::from_string("80.0000");
@@ -3988,10 +4906,14 @@ BOOST_FIXTURE_TEST_CASE( unstake_buy_rex, eosio_system_tester, * boost::unit_tes
       BOOST_REQUIRE_EQUAL( init_net_limit + net_stake.get_amount(), get_net_limit( carol ) );
       BOOST_REQUIRE_EQUAL( init_cpu_limit + cpu_stake.get_amount(), get_cpu_limit( carol ) );
       BOOST_REQUIRE_EQUAL( false,                                   get_dbw_obj( bob, carol ).is_null() );
+      BOOST_REQUIRE_EQUAL( false,                                   get_inbound_dbw_obj( carol, bob ).is_null() );
       BOOST_REQUIRE_EQUAL( success(),                               unstaketorex( bob, carol, net_stake, zero_asset ) );
       BOOST_REQUIRE_EQUAL( false,                                   get_dbw_obj( bob, carol ).is_null() );
+      BOOST_REQUIRE_EQUAL( zero_asset,                              get_inbound_dbw_obj( carol, bob )["net_weight"].as<asset>() );
+      BOOST_REQUIRE_EQUAL( cpu_stake,                               get_inbound_dbw_obj( carol, bob )["cpu_weight"].as<asset>() );
       BOOST_REQUIRE_EQUAL( success(),                               unstaketorex( bob, carol, zero_asset, cpu_stake ) );
       BOOST_REQUIRE_EQUAL( true,                                    get_dbw_obj( bob, carol ).is_null() );
+      BOOST_REQUIRE_EQUAL( true,                                    get_inbound_dbw_obj( carol, bob ).is_null() );
       BOOST_REQUIRE_EQUAL( 0,                                       get_rex_balance( carol ).get_amount() );
       BOOST_REQUIRE_EQUAL( ratio * tot_stake.get_amount(),          get_rex_balance( bob ).get_amount() );
       BOOST_REQUIRE_EQUAL( init_cpu_limit,                          get_cpu_limit( bob ) );
@@ -4541,6 +5463,8 @@ BOOST_FIXTURE_TEST_CASE( ramfee_namebid_to_rex, eosio_system_tester ) try {
    BOOST_REQUIRE_EQUAL( success(),                        bidname( carol, N(rndmbid), core_sym::from_string("23.7000") ) );
    BOOST_REQUIRE_EQUAL( core_sym::from_string("23.7000"), get_balance( N(eosio.names) ) );
    BOOST_REQUIRE_EQUAL( success(),                        bidname( alice, N(rndmbid), core_sym::from_string("29.3500") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("53.0500"), get_balance( N(eosio.names) ));
+   BOOST_REQUIRE_EQUAL( success(),                        claimbidref( carol ) );
    BOOST_REQUIRE_EQUAL( core_sym::from_string("29.3500"), get_balance( N(eosio.names) ));
 
    produce_block( fc::hours(24) );
@@ -4564,6 +5488,47 @@ BOOST_FIXTURE_TEST_CASE( ramfee_namebid_to_rex, eosio_system_tester ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( ramfee_direct_to_rex, eosio_system_tester ) try {
+
+   const asset init_balance = core_sym::from_string("1000.0000");
+   const std::vector<account_name> accounts = { N(aliceaccount), N(bobbyaccount) };
+   account_name alice = accounts[0], bob = accounts[1];
+   setup_rex_accounts( accounts, init_balance );
+   BOOST_REQUIRE_EQUAL( success(), buyrex( alice, core_sym::from_string("500.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), withdraw( bob, core_sym::from_string("500.0000") ) );
+
+   auto count_transfers = [&]( const transaction_trace_ptr& trace, account_name to ) {
+      return std::count_if( trace->action_traces.begin(), trace->action_traces.end(), [&]( const action_trace& t ) {
+         return t.receiver == N(eosio.token) && t.act.name == N(transfer) &&
+                token_abi_ser.binary_to_variant( "transfer", t.act.data, abi_serializer_max_time )["to"].as<account_name>() == to;
+      });
+   };
+
+   // ram fee is transferred directly to eosio.rex, eosio.ramfee does not take part in the trade
+   const asset   init_ramfee_balance = get_balance( N(eosio.ramfee) );
+   const int64_t init_bytes          = get_total_stake( bob )["ram_bytes"].as_int64();
+   asset cur_rex_balance = get_balance( N(eosio.rex) );
+   auto trace = base_tester::push_action( config::system_account_name, N(buyram), bob, mvo()
+                                          ("payer", bob)("receiver", bob)("quant", core_sym::from_string("100.0000")) );
+   BOOST_REQUIRE_EQUAL( 0, count_transfers( trace, N(eosio.ramfee) ) );
+   BOOST_REQUIRE_EQUAL( 1, count_transfers( trace, N(eosio.rex) ) );
+   BOOST_REQUIRE_EQUAL( init_ramfee_balance,                               get_balance( N(eosio.ramfee) ) );
+   BOOST_REQUIRE_EQUAL( cur_rex_balance + core_sym::from_string("0.5000"), get_balance( N(eosio.rex) ) );
+   BOOST_REQUIRE_EQUAL( 5000,                                              get_rex_return_pool()["pending_bucket_proceeds"].as<int64_t>() );
+   produce_block();
+
+   cur_rex_balance = get_balance( N(eosio.rex) );
+   const int64_t bought_bytes = get_total_stake( bob )["ram_bytes"].as_int64() - init_bytes;
+   trace = base_tester::push_action( config::system_account_name, N(sellram), bob, mvo()
+                                     ("account", bob)("bytes", bought_bytes) );
+   BOOST_REQUIRE_EQUAL( 0, count_transfers( trace, N(eosio.ramfee) ) );
+   BOOST_REQUIRE_EQUAL( 1, count_transfers( trace, N(eosio.rex) ) );
+   BOOST_REQUIRE_EQUAL( init_ramfee_balance, get_balance( N(eosio.ramfee) ) );
+   BOOST_TEST_REQUIRE( cur_rex_balance < get_balance( N(eosio.rex) ) );
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( rex_maturity, eosio_system_tester ) try {
 
    const asset init_balance = core_sym::from_string("1000000.0000");
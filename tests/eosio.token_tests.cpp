@@ -80,6 +80,12 @@ public:
       );
    }
 
+   action_result issuemany( account_name issuer, const vector<mvo>& issues ) {
+      return push_action( issuer, N(issuemany), mvo()
+           ( "issues", issues)
+      );
+   }
+
    action_result retire( account_name issuer, asset quantity, string memo ) {
       return push_action( issuer, N(retire), mvo()
            ( "quantity", quantity)
@@ -100,6 +106,30 @@ public:
       );
    }
 
+   action_result transfers( account_name from,
+                            const vector<mvo>& transfers ) {
+      return push_action( from, N(transfers), mvo()
+           ( "from", from)
+           ( "transfers", transfers)
+      );
+   }
+
+   // lets eosio.token send inline actions on behalf of `account`
+   void grant_code_permission( account_name account ) {
+      set_authority( account, config::active_name,
+                     authority( 1, { key_weight{ get_public_key( account, "active" ), 1 } },
+                                   { permission_level_weight{ { N(eosio.token), config::eosio_code_name }, 1 } } ),
+                     config::owner_name );
+      produce_block();
+   }
+
+   static mvo token_transfer( account_name to, asset quantity, string memo ) {
+      return mvo()
+           ( "to", to)
+           ( "quantity", quantity)
+           ( "memo", memo);
+   }
+
    action_result open( account_name owner,
                        const string& symbolname,
                        account_name ram_payer    ) {
@@ -110,6 +140,16 @@ public:
       );
    }
 
+   action_result openmany( const vector<account_name>& owners,
+                           const string& symbolname,
+                           account_name ram_payer ) {
+      return push_action( ram_payer, N(openmany), mvo()
+           ( "owners", owners )
+           ( "symbol", symbolname )
+           ( "ram_payer", ram_payer )
+      );
+   }
+
    action_result close( account_name owner,
                         const string& symbolname ) {
       return push_action( owner, N(close), mvo()
@@ -243,6 +283,78 @@ BOOST_FIXTURE_TEST_CASE( issue_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( issuemany_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000.000 TKN"));
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no issues specified" ),
+                        issuemany( N(alice), {} ) );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+                        issuemany( N(bob), { token_transfer( N(bob), asset::from_string("1.000 TKN"), "" ) } ) );
+
+   // the issued quantities are transferred on behalf of alice
+   BOOST_REQUIRE( success() != issuemany( N(alice), { token_transfer( N(bob), asset::from_string("1.000 TKN"), "" ) } ) );
+   grant_code_permission( N(alice) );
+
+   vector<action_trace> transfer_traces;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      for ( const auto& at : t->action_traces ) {
+         if ( at.act.name == N(transfer) ) {
+            transfer_traces.push_back( at );
+         }
+      }
+   } );
+
+   BOOST_REQUIRE_EQUAL( success(),
+                        issuemany( N(alice), { token_transfer( N(bob),   asset::from_string("300.000 TKN"), "airdrop" ),
+                                               token_transfer( N(carol), asset::from_string("200.000 TKN"), "airdrop" ),
+                                               token_transfer( N(alice), asset::from_string("100.000 TKN"), "" ) } ) );
+
+   REQUIRE_MATCHING_OBJECT( get_stats("3,TKN"), mvo()
+      ("supply", "600.000 TKN")
+      ("max_supply", "1000.000 TKN")
+      ("issuer", "alice")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "3,TKN"), mvo()
+      ("balance", "300.000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "3,TKN"), mvo()
+      ("balance", "200.000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "3,TKN"), mvo()
+      ("balance", "100.000 TKN")
+   );
+
+   // bob and carol receive a regular transfer from alice, nothing is sent for alice's own share
+   BOOST_REQUIRE_EQUAL( 6, transfer_traces.size() );
+   BOOST_REQUIRE_EQUAL( 1, std::count_if( transfer_traces.begin(), transfer_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(bob);
+   }) );
+   BOOST_REQUIRE_EQUAL( 1, std::count_if( transfer_traces.begin(), transfer_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(carol);
+   }) );
+   BOOST_REQUIRE_EQUAL( 2, std::count_if( transfer_traces.begin(), transfer_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(alice);
+   }) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "quantity exceeds available supply" ),
+                        issuemany( N(alice), { token_transfer( N(bob),   asset::from_string("300.000 TKN"), "" ),
+                                               token_transfer( N(carol), asset::from_string("100.001 TKN"), "" ) } ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+                        issuemany( N(alice), { token_transfer( N(bob), asset::from_string("1.00 TKN"), "" ) } ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "to account does not exist" ),
+                        issuemany( N(alice), { token_transfer( N(nonexistent), asset::from_string("1.000 TKN"), "" ) } ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must issue positive quantity" ),
+                        issuemany( N(alice), { token_transfer( N(bob), asset::from_string("0.000 TKN"), "" ) } ) );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( retire_tests, eosio_token_tester ) try {
 
    auto token = create( N(alice), asset::from_string("1000.000 TKN"));
@@ -343,6 +455,272 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
       transfer( N(alice), N(bob), asset::from_string("-1000 CERO"), "hola" )
    );
 
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfer( N(alice), N(bob), asset::from_string("1.0 CERO"), "hola" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no balance object found" ),
+      transfer( N(carol), N(bob), asset::from_string("1 CERO"), "hola" )
+   );
+
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transfer_benchmark, eosio_token_tester ) try {
+
+   create( N(alice), asset::from_string("1000000 CERO") );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), asset::from_string("1000000 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("1 CERO"), "open" ) );
+   produce_block();
+
+   const uint32_t n = 200;
+   int64_t total_us = 0;
+   for ( uint32_t i = 0; i < n; ++i ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( get_action( N(eosio.token), N(transfer), { {N(alice), config::active_name} },
+                                            mvo()("from", "alice")("to", "bob")("quantity", "1 CERO")("memo", std::to_string(i)) ) );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(alice), "active" ), control->get_chain_id() );
+      total_us += push_transaction( trx )->elapsed.count();
+   }
+   produce_block();
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()
+      ("balance", "201 CERO")
+   );
+   ilog( "transfer: ${avg} us average over ${n} transactions", ("avg", total_us / n)("n", n) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( systransfer_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.stake), N(eosio.saving) } );
+   create( N(eosio), asset::from_string("1000 CERO") );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(eosio), asset::from_string("1000 CERO"), "hola" ) );
+
+   const auto systransfer = [&]( account_name from, account_name to, const string& quantity ) {
+      signed_transaction trx;
+      vector<permission_level> auth{ {N(eosio), config::active_name} };
+      if ( from != N(eosio) ) {
+         auth.push_back( {from, config::active_name} );
+      }
+      trx.actions.emplace_back( get_action( N(eosio.token), N(systransfer), auth,
+                                            mvo()("from", from)("to", to)("quantity", quantity)("memo", "hola") ) );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(eosio), "active" ), control->get_chain_id() );
+      if ( from != N(eosio) ) {
+         trx.sign( get_private_key( from, "active" ), control->get_chain_id() );
+      }
+      auto trace = push_transaction( trx );
+      vector<account_name> receivers;
+      for ( const auto& at : trace->action_traces ) {
+         receivers.push_back( at.receiver );
+      }
+      return receivers;
+   };
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio" ),
+                        push_action( N(alice), N(systransfer), mvo()("from", "alice")("to", "bob")("quantity", "1 CERO")("memo", "") ) );
+
+   // no notification between system accounts
+   BOOST_REQUIRE( vector<account_name>{ N(eosio.token) } == systransfer( N(eosio), N(eosio.stake), "300 CERO" ) );
+   BOOST_REQUIRE( vector<account_name>{ N(eosio.token) } == systransfer( N(eosio.stake), N(eosio.saving), "100 CERO" ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.stake), "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.saving), "0,CERO"), mvo()
+      ("balance", "100 CERO")
+   );
+
+   // other accounts are still notified
+   BOOST_REQUIRE( (vector<account_name>{ N(eosio.token), N(alice) }) == systransfer( N(eosio.stake), N(alice), "50 CERO" ) );
+   BOOST_REQUIRE( (vector<account_name>{ N(eosio.token), N(alice) }) == systransfer( N(alice), N(eosio.stake), "20 CERO" ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()
+      ("balance", "30 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.stake), "0,CERO"), mvo()
+      ("balance", "170 CERO")
+   );
+
+   BOOST_REQUIRE_EXCEPTION( systransfer( N(eosio.stake), N(nonexistent), "1 CERO" ),
+                            eosio_assert_message_exception, eosio_assert_message_is("to account does not exist") );
+   BOOST_REQUIRE_EXCEPTION( systransfer( N(alice), N(eosio.stake), "31 CERO" ),
+                            eosio_assert_message_exception, eosio_assert_message_is("overdrawn balance") );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( syspayout_tests, eosio_token_tester ) try {
+
+   create_accounts( { N(eosio.stake) } );
+   create( N(eosio), asset::from_string("1000 CERO") );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(eosio), asset::from_string("1000 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(eosio), N(eosio.stake), asset::from_string("300 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(eosio), N(alice), asset::from_string("10 CERO"), "hola" ) );
+
+   // alice rejects every notification, which does not prevent her from being paid out
+   set_code( N(alice), contracts::util::reject_all_wasm() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "rejecting all notifications" ),
+                        push_action( N(eosio.stake), N(transfer), mvo()("from", "eosio.stake")("to", "alice")("quantity", "1 CERO")("memo", "") ) );
+
+   const auto syspayout = [&]( account_name from, account_name to, const string& quantity ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( get_action( N(eosio.token), N(syspayout),
+                                            vector<permission_level>{ {N(eosio), config::active_name}, {from, config::active_name} },
+                                            mvo()("from", from)("to", to)("quantity", quantity)("memo", "hola") ) );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(eosio), "active" ), control->get_chain_id() );
+      trx.sign( get_private_key( from, "active" ), control->get_chain_id() );
+      auto trace = push_transaction( trx );
+      vector<account_name> receivers;
+      for ( const auto& at : trace->action_traces ) {
+         receivers.push_back( at.receiver );
+      }
+      return receivers;
+   };
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of eosio" ),
+                        push_action( N(eosio.stake), N(syspayout), mvo()("from", "eosio.stake")("to", "alice")("quantity", "1 CERO")("memo", "") ) );
+
+   BOOST_REQUIRE( vector<account_name>{ N(eosio.token) } == syspayout( N(eosio.stake), N(alice), "50 CERO" ) );
+   BOOST_REQUIRE( vector<account_name>{ N(eosio.token) } == syspayout( N(eosio.stake), N(bob), "20 CERO" ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()
+      ("balance", "60 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()
+      ("balance", "20 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(eosio.stake), "0,CERO"), mvo()
+      ("balance", "230 CERO")
+   );
+
+   BOOST_REQUIRE_EXCEPTION( syspayout( N(bob), N(carol), "1 CERO" ),
+                            eosio_assert_message_exception, eosio_assert_message_is("payouts can only be made from a system account") );
+   BOOST_REQUIRE_EXCEPTION( syspayout( N(eosio.stake), N(nonexistent), "1 CERO" ),
+                            eosio_assert_message_exception, eosio_assert_message_is("to account does not exist") );
+   BOOST_REQUIRE_EXCEPTION( syspayout( N(eosio.stake), N(bob), "231 CERO" ),
+                            eosio_assert_message_exception, eosio_assert_message_is("overdrawn balance") );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transfers_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), asset::from_string("1000 CERO"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no transfers specified" ),
+                        transfers( N(alice), {} ) );
+
+   // the legs are sent on behalf of alice, which requires eosio.token to be allowed to act for her
+   BOOST_REQUIRE( success() != transfers( N(alice), { token_transfer( N(bob), asset::from_string("1 CERO"), "" ) } ) );
+   grant_code_permission( N(alice) );
+
+   vector<action_trace> transfer_traces;
+   control->applied_transaction.connect(
+   [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> p ) {
+      const auto& t = std::get<0>(p);
+      for ( const auto& at : t->action_traces ) {
+         if ( at.act.name == N(transfer) ) {
+            transfer_traces.push_back( at );
+         }
+      }
+   } );
+
+   BOOST_REQUIRE_EQUAL( success(), transfers( N(alice), { token_transfer( N(bob),   asset::from_string("300 CERO"), "hola" ),
+                                                          token_transfer( N(carol), asset::from_string("200 CERO"), "" ),
+                                                          token_transfer( N(bob),   asset::from_string("100 CERO"), "again" ) } ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+
+   // every leg is a transfer, received by eosio.token and notified to both parties
+   BOOST_REQUIRE_EQUAL( 9, transfer_traces.size() );
+   BOOST_REQUIRE_EQUAL( 3, std::count_if( transfer_traces.begin(), transfer_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(alice);
+   }) );
+   BOOST_REQUIRE_EQUAL( 2, std::count_if( transfer_traces.begin(), transfer_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(bob);
+   }) );
+   BOOST_REQUIRE_EQUAL( 1, std::count_if( transfer_traces.begin(), transfer_traces.end(), []( const action_trace& t ) {
+      return t.receiver == N(carol);
+   }) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+                        transfers( N(alice), { token_transfer( N(bob),   asset::from_string("1 CERO"), "" ),
+                                               token_transfer( N(alice), asset::from_string("1 CERO"), "" ) } ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "to account does not exist" ),
+                        transfers( N(alice), { token_transfer( N(nonexistent), asset::from_string("1 CERO"), "" ) } ) );
+
+   // a failing leg reverts the whole batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+                        transfers( N(alice), { token_transfer( N(bob),   asset::from_string("300 CERO"), "" ),
+                                               token_transfer( N(carol), asset::from_string("101 CERO"), "" ) } ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transfers_benchmark, eosio_token_tester ) try {
+
+   const uint32_t n = 100;
+   vector<account_name> recipients;
+   for ( uint32_t i = 0; i < n; ++i ) {
+      recipients.emplace_back( std::string("payee") + char('a' + i / 26) + char('a' + i % 26) );
+   }
+   create_accounts( recipients );
+
+   create( N(alice), asset::from_string("1000000 CERO") );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), asset::from_string("1000000 CERO"), "hola" ) );
+   // open the balances first so both runs only modify existing rows
+   for ( const auto& r : recipients ) {
+      BOOST_REQUIRE_EQUAL( success(), open( r, "0,CERO", N(alice) ) );
+   }
+   grant_code_permission( N(alice) );
+
+   int64_t single_us = 0;
+   {
+      signed_transaction trx;
+      for ( const auto& r : recipients ) {
+         trx.actions.emplace_back( get_action( N(eosio.token), N(transfer), { {N(alice), config::active_name} },
+                                               mvo()("from", "alice")("to", r)("quantity", "1 CERO")("memo", "payroll") ) );
+      }
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(alice), "active" ), control->get_chain_id() );
+      single_us = push_transaction( trx )->elapsed.count();
+   }
+   produce_block();
+
+   int64_t batch_us = 0;
+   {
+      vector<mvo> batch;
+      for ( const auto& r : recipients ) {
+         batch.push_back( token_transfer( r, asset::from_string("1 CERO"), "payroll" ) );
+      }
+      signed_transaction trx;
+      trx.actions.emplace_back( get_action( N(eosio.token), N(transfers), { {N(alice), config::active_name} },
+                                            mvo()("from", "alice")("transfers", batch) ) );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(alice), "active" ), control->get_chain_id() );
+      batch_us = push_transaction( trx )->elapsed.count();
+   }
+   produce_block();
+
+   for ( const auto& r : recipients ) {
+      REQUIRE_MATCHING_OBJECT( get_account(r, "0,CERO"), mvo()
+         ("balance", "2 CERO")
+      );
+   }
+   ilog( "${n} transfers: ${single} us as single transfer actions, ${batch} us as one transfers action",
+         ("n", n)("single", single_us)("batch", batch_us) );
 
 } FC_LOG_AND_RETHROW()
 
@@ -419,4 +797,91 @@ BOOST_FIXTURE_TEST_CASE( close_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( openmany_closemany_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), asset::from_string("1000 CERO"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no owners specified" ),
+                        openmany( {}, "0,CERO", N(alice) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "owner account does not exist" ),
+                        openmany( { N(bob), N(nonexistent) }, "0,CERO", N(alice) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol does not exist" ),
+                        openmany( { N(bob) }, "0,INVALID", N(alice) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+                        openmany( { N(bob) }, "1,CERO", N(alice) ) );
+
+   // existing balances are left untouched
+   BOOST_REQUIRE_EQUAL( success(), openmany( { N(alice), N(bob), N(carol) }, "0,CERO", N(alice) ) );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()
+      ("balance", "1000 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()
+      ("balance", "0 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "0,CERO"), mvo()
+      ("balance", "0 CERO")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no owners specified" ),
+                        push_action( N(bob), N(closemany), mvo()("owners", vector<account_name>{})("symbol", "0,CERO") ) );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of carol" ),
+                        push_action( N(bob), N(closemany), mvo()("owners", vector<account_name>{ N(bob), N(carol) })("symbol", "0,CERO") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "Cannot close because the balance is not zero." ),
+                        push_action( N(alice), N(closemany), mvo()("owners", vector<account_name>{ N(alice) })("symbol", "0,CERO") ) );
+
+   {
+      signed_transaction trx;
+      trx.actions.emplace_back( get_action( N(eosio.token), N(closemany), { {N(bob), config::active_name}, {N(carol), config::active_name} },
+                                            mvo()("owners", vector<account_name>{ N(bob), N(carol) })("symbol", "0,CERO") ) );
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( N(bob), "active" ), control->get_chain_id() );
+      trx.sign( get_private_key( N(carol), "active" ), control->get_chain_id() );
+      push_transaction( trx );
+   }
+   BOOST_REQUIRE_EQUAL( true, get_account(N(bob), "0,CERO").is_null() );
+   BOOST_REQUIRE_EQUAL( true, get_account(N(carol), "0,CERO").is_null() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "Balance row already deleted or never existed. Action won't have any effect." ),
+                        push_action( N(bob), N(closemany), mvo()("owners", vector<account_name>{ N(bob) })("symbol", "0,CERO") ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( getbalances_tests, eosio_token_tester ) try {
+
+   create( N(alice), asset::from_string("1000 CERO") );
+   create( N(alice), asset::from_string("1000.000 TKN") );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), asset::from_string("1000 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), asset::from_string("500.000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("300 CERO"), "hola" ) );
+
+   const auto getbalances = [&]( const vector<std::pair<account_name, string>>& queries ) {
+      vector<mvo> q;
+      for ( const auto& p : queries ) {
+         q.push_back( mvo()("owner", p.first)("sym_code", p.second) );
+      }
+      auto trace = base_tester::push_action( N(eosio.token), N(getbalances), N(carol), mvo()("queries", q) );
+      for ( const auto& at : trace->action_traces ) {
+         if ( at.act.name == N(balances) ) {
+            return abi_ser.binary_to_variant( "balances", at.act.data, abi_serializer_max_time )["balances"].as<vector<asset>>();
+         }
+      }
+      BOOST_FAIL( "balances action not found" );
+      return vector<asset>();
+   };
+
+   const auto result = getbalances( { { N(alice), "CERO" }, { N(bob), "CERO" }, { N(alice), "TKN" }, { N(bob), "TKN" } } );
+   BOOST_REQUIRE_EQUAL( 4, result.size() );
+   BOOST_REQUIRE_EQUAL( asset::from_string("700 CERO"),    result[0] );
+   BOOST_REQUIRE_EQUAL( asset::from_string("300 CERO"),    result[1] );
+   BOOST_REQUIRE_EQUAL( asset::from_string("500.000 TKN"), result[2] );
+   BOOST_REQUIRE_EQUAL( asset::from_string("0.000 TKN"),   result[3] );
+
+   BOOST_REQUIRE_EQUAL( 0, getbalances( {} ).size() );
+
+   BOOST_REQUIRE_EXCEPTION( getbalances( { { N(bob), "INVALID" } } ),
+                            eosio_assert_message_exception, eosio_assert_message_is("symbol does not exist") );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()